@@ -0,0 +1,133 @@
+// ----------------------------------------
+// Heap census
+// ----------------------------------------
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include "dbas7.hpp"
+#include "heap.hpp"
+using namespace std;
+
+
+// Memory accounting on top of the Heap's counters. Each (call line, callee) pair is a site, and the
+// heap charges allocations, frees, shares and copy-on-write copies to the site of the running call.
+// The report has live pages and bytes by page type, counts by function and by call site, and the
+// pages still live at exit that were made after main started: a diff of two heap snapshots.
+struct Census {
+	struct Site  { int32_t fidx; Prog::Dsym dsym; };  // callee, and where it was called from
+	struct Page  { string type; int64_t bytes; int32_t site; };
+	struct Group { int64_t pages, bytes; };
+	typedef  unordered_map<int64_t, Page>  Snapshot;  // live pages by serial
+
+	Heap*                             heap = NULL;
+	vector<Site>                      sites;
+	unordered_map<uint64_t, int32_t>  siteids;  // callee, file, line -> site
+	vector<int32_t>                   stack;    // sites of the calls below the running one
+	int32_t                           mainfn = -1;
+	Snapshot                          atmain;   // the heap as main started
+
+
+	// === collect ===
+
+	void start(Heap& h, int32_t main) {
+		heap = &h,  mainfn = main;
+		sites = { { -1, { 0, 0 } } };  // site 0: startup, outside any call
+		siteids = {},  stack = {};
+		h.track = 1,  h.site = 0,  h.counts.assign(1, {});
+	}
+	void enter(int32_t fidx, Prog::Dsym d) {
+		if (fidx == mainfn && stack.empty())  atmain = snapshot();
+		uint64_t key = (uint64_t)fidx << 40 | (uint64_t)(d.fno & 0xffff) << 24 | (d.lno & 0xffffff);
+		auto it = siteids.find(key);
+		if (it == siteids.end()) {
+			it = siteids.emplace(key, sites.size()).first;
+			sites.push_back({ fidx, d }),  heap->counts.push_back({});
+		}
+		stack.push_back(heap->site);
+		heap->site = it->second;
+	}
+	void leave() {
+		heap->site = stack.back();
+		stack.pop_back();
+	}
+
+	Snapshot snapshot() const {
+		Snapshot snap;
+		heap->each([&](const Heap::Slot& sl) {
+			snap.emplace(sl.serial, Page{ sl.body->page.type, Heap::bytes(sl.body->page), sl.site });
+		});
+		return snap;
+	}
+	// pages live in b and not in a, by site and type
+	static map<pair<int32_t, string>, Group> diff(const Snapshot& a, const Snapshot& b) {
+		map<pair<int32_t, string>, Group> d;
+		for (auto& p : b)
+			if (!a.count(p.first)) {
+				auto& g = d[{ p.second.site, p.second.type }];
+				g.pages++,  g.bytes += p.second.bytes;
+			}
+		return d;
+	}
+
+
+	// === report ===
+
+	string sitename(const Prog& prog, int32_t s) const {
+		auto& st = sites.at(s);
+		if (st.fidx == -1)     return "<startup>";
+		if (st.dsym.fno == 0)  return prog.functions[st.fidx].name;
+		return prog.functions[st.fidx].name + " @ " + prog.files.at(st.dsym.fno - 1) + ":" + to_string(st.dsym.lno);
+	}
+
+	void show(const Prog& prog, size_t top=10) {
+		auto& counts = heap->counts;
+		// live pages by type. shared bodies count once, to the first page seen on them
+		map<string, Group> types;
+		unordered_set<const Heap::Body*> seen;
+		int64_t total = 0;
+		heap->each([&](const Heap::Slot& sl) {
+			auto& g = types[sl.body->page.type];
+			g.pages++;
+			if (seen.insert(sl.body).second)  g.bytes += Heap::bytes(sl.body->page),  total += Heap::bytes(sl.body->page);
+		});
+		printf("  census: %d pages, %lld bytes live | peak %d pages\n", (int)heap->size(), (long long)total, heap->peak);
+		printf("    %-20s %8s %10s\n", "type", "pages", "bytes");
+		for (auto& t : types)
+			printf("    %-20s %8lld %10lld\n", t.first.c_str(), (long long)t.second.pages, (long long)t.second.bytes);
+		// by function, and by call site
+		auto row = [](const string& name, const Heap::Count& c) {
+			printf("    %8lld %8lld %8lld %8lld %10lld  %s\n", (long long)c.allocs, (long long)c.frees, (long long)c.shares,
+				(long long)c.unshares, (long long)c.copied, name.c_str());
+		};
+		auto add = [](Heap::Count& a, const Heap::Count& b) {
+			a.allocs += b.allocs,  a.frees += b.frees,  a.shares += b.shares,  a.unshares += b.unshares,  a.copied += b.copied;
+		};
+		map<int32_t, Heap::Count> funcs;
+		for (size_t s = 0; s < sites.size(); s++)  add(funcs[sites[s].fidx], counts[s]);
+		vector<pair<int32_t, Heap::Count>> fs( funcs.begin(), funcs.end() );
+		auto byallocs = [](auto& a, auto& b) { return a.second.allocs + a.second.shares > b.second.allocs + b.second.shares; };
+		sort(fs.begin(), fs.end(), byallocs);
+		printf("    %8s %8s %8s %8s %10s  %s\n", "allocs", "frees", "shares", "unshares", "copied", "function");
+		for (size_t i = 0; i < fs.size() && i < top; i++)
+			row(fs[i].first == -1 ? "<startup>" : prog.functions[fs[i].first].name, fs[i].second);
+		vector<pair<int32_t, Heap::Count>> ss;
+		for (size_t s = 0; s < sites.size(); s++)  ss.push_back({ s, counts[s] });
+		sort(ss.begin(), ss.end(), byallocs);
+		printf("    %8s %8s %8s %8s %10s  %s\n", "allocs", "frees", "shares", "unshares", "copied", "call site");
+		for (size_t i = 0; i < ss.size() && i < top; i++)
+			row(sitename(prog, ss[i].first), ss[i].second);
+		// what the run left behind
+		auto d = diff(atmain, snapshot());
+		vector<pair<pair<int32_t, string>, Group>> ds( d.begin(), d.end() );
+		sort(ds.begin(), ds.end(), [](auto& a, auto& b) { return a.second.bytes > b.second.bytes; });
+		printf("    %8s %10s  %s\n", "pages", "bytes", "live at exit, made after main started");
+		for (size_t i = 0; i < ds.size() && i < top; i++)
+			printf("    %8lld %10lld  %s in %s\n", (long long)ds[i].second.pages, (long long)ds[i].second.bytes,
+				ds[i].first.second.c_str(), sitename(prog, ds[i].first.first).c_str());
+	}
+};
@@ -0,0 +1,474 @@
+// ----------------------------------------
+// Bytecode compiler
+// ----------------------------------------
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include "dbas7.hpp"
+using namespace std;
+
+
+// one flat instruction set for expressions, variable paths and statements.
+// stack machine: ints, heap handles and string views on the value stack, variable references on rstack.
+// listed once here, so the enum, the name table and the VM's threaded dispatch table stay in order
+#define DBAS_OPS(X) \
+	X(noop) \
+	/* integers */ \
+	X(i) X(add) X(sub) X(mul) X(div) X(and_) X(or_) \
+	X(eq) X(neq) X(lt) X(gt) X(lte) X(gte) \
+	/* strings */ \
+	X(lit) X(strcat) X(eq_str) X(neq_str) \
+	/* variable references */ \
+	X(ref_local) X(ref_global) X(ref_index) X(ref_prop) X(ref_chr) X(load) X(load_str) \
+	X(ref_index_w) X(ref_prop_w) X(ref_chr_w) X(ref_index_at) X(ref_chr_at) X(pin) \
+	/* assignment */ \
+	X(store) X(store_str) X(append_str) X(store_obj) X(store_move) X(dim_make) X(dim_str) X(dim_clone) X(inc) \
+	/* control */ \
+	X(jmp) X(jz) X(jnz) X(call) X(ret) X(ret_str) X(ret_obj) X(ret_new) \
+	X(pop) X(pop_str) X(pop_obj) X(hold) X(unhold) X(unpin) X(halt) \
+	/* system functions */ \
+	X(sys_push) X(sys_pop) X(sys_len) X(sys_len_str) X(sys_default) \
+	/* I/O */ \
+	X(print_int) X(print_str) X(print_lit) X(print_nl) X(input) \
+	/* superinstructions (Compiler::superinstr) */ \
+	X(load_local) X(load_global) X(add_i) X(sub_i) X(inc_local) \
+	X(jz_eq) X(jz_neq) X(jz_lt) X(jz_gt) X(jz_lte) X(jz_gte) X(jnz_lt) X(jnz_gt) \
+	/* profiling, tracing and heap census (Compiler::profile, trace, census) */ \
+	X(line) X(trace_sys) X(trace_end) X(site)
+
+enum class Op : int32_t {
+	#define X(name)  name,
+	DBAS_OPS(X)
+	#undef X
+	OP_COUNT
+};
+
+const char* opname(Op op) {
+	static const char* NAMES[] = {
+		#define X(name)  #name,
+		DBAS_OPS(X)
+		#undef X
+	};
+	return op >= Op::noop && op < Op::OP_COUNT ? NAMES[(int)op] : "<BAD_OP>";
+}
+
+
+struct Bytecode {
+	struct Instr { Op op; int32_t a, b; };
+	vector<Instr>   code;
+	vector<int32_t> entry;   // code offset of each function, by Prog::functions index
+	vector<string>  types;   // type names used by dim_make / dim_clone
+
+	int tofile(const string& fname) const {
+		fstream fs(fname, ios::out);
+		if (!fs.is_open())
+			return fprintf(stderr, "could not open file: %s\n", fname.c_str()), 1;
+		vector<int32_t> label(code.size(), -1);  // function starting at each pc
+		for (size_t f = 0; f < entry.size(); f++)
+			if (entry[f] > -1)  label.at(entry[f]) = f;
+		for (size_t pc = 0; pc < code.size(); pc++) {
+			if (label[pc] > -1)  fs << "\n" << "function " << label[pc] << ":" << "\n";
+			fs << "\t" << pc << "\t" << opname(code[pc].op) << "\t" << code[pc].a << "\t" << code[pc].b << "\n";
+		}
+		printf("wrote bytecode output to: %s\n", fname.c_str());
+		return 0;
+	}
+};
+
+
+struct Compiler {
+	struct Loop { vector<int32_t> breaks, conts; };  // jumps waiting for the loop's end / continue target
+	const Prog& prog;
+	Bytecode bc;
+	vector<Loop> loops;
+	unordered_map<string, int32_t> typeids;  // type name -> index in bc.types
+	int32_t cfunc = -1;
+	int32_t pins  = 0;   // pin ops emitted so far, for the unpin after a call
+	int superinstr = 1;  // fuse common instruction pairs
+	int profile = 0;     // mark each statement's start with its source line
+	int trace = 0;       // trace begin / end around system calls
+	int census = 0;      // pass each user call's source line to the heap census
+
+	Compiler(const Prog& _prog) : prog(_prog) { }
+
+
+	// === api ===
+
+	Bytecode compile() {
+		bc = {},  typeids = {};
+		bc.entry.resize(prog.functions.size(), -1);
+		// program start: globals, then main
+		for (size_t i = 0; i < prog.globals.size(); i++)
+			c_dim(prog.globals[i], Op::ref_global, i);
+		int32_t fmain = funcindex("main");
+		if (fmain == -1)  throw runtime_error("missing function: main");
+		if (census)  emit(Op::site, 0, 0);
+		emit(Op::call, fmain, 0);
+		emit(Op::halt);
+		// functions
+		for (size_t i = 0; i < prog.functions.size(); i++)
+			c_function(i);
+		// resolve call targets
+		for (auto& in : bc.code)
+			if (in.op == Op::call)  in.b = bc.entry.at(in.a);
+		if (superinstr)  fuse();
+		return bc;
+	}
+
+
+	// === helpers ===
+
+	int32_t here() const { return bc.code.size(); }
+	int32_t emit(Op op, int32_t a=0, int32_t b=0) {
+		bc.code.push_back({ op, a, b });
+		return bc.code.size() - 1;
+	}
+	void patch(int32_t pc, int32_t target) { bc.code.at(pc).a = target; }
+	void patch(const vector<int32_t>& pcs, int32_t target) { for (auto pc : pcs)  patch(pc, target); }
+	int32_t typeid_(const string& type) {
+		auto it = typeids.find(type);
+		if (it != typeids.end())  return it->second;
+		bc.types.push_back(type);
+		return typeids[type] = bc.types.size() - 1;
+	}
+	int32_t funcindex(const string& name) const {
+		for (size_t i = 0; i < prog.functions.size(); i++)
+			if (prog.functions[i].name == name)  return i;
+		return -1;
+	}
+	static int is_jump(Op op) {
+		switch (op) {
+		case Op::jmp:  case Op::jz:  case Op::jnz:
+		case Op::jz_eq:  case Op::jz_neq:  case Op::jz_lt:  case Op::jz_gt:  case Op::jz_lte:  case Op::jz_gte:
+		case Op::jnz_lt:  case Op::jnz_gt:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+
+	// === functions and dims ===
+
+	void c_function(int32_t fidx) {
+		const auto& fn = prog.functions.at(fidx);
+		cfunc = fidx;
+		bc.entry.at(fidx) = here();
+		for (size_t i = 0; i < fn.locals.size(); i++)
+			c_dim(fn.locals[i], Op::ref_local, fn.args.size() + i);
+		c_block(fn.block);
+		if    (fn.type == "int")  emit(Op::i, 0),  emit(Op::ret, fidx);  // default return value
+		else  emit(Op::ret_new, fidx);
+		cfunc = -1;
+	}
+
+	void c_dim(const Prog::Dim& d, Op ref, int32_t slot) {
+		emit(ref, slot);
+		if      (d.expr > -1 && d.type == "string")  c_expr(d.expr),  emit(Op::dim_str);
+		else if (d.expr > -1 && prog.exprs.at(d.expr).temp())  c_expr(d.expr),  emit(Op::store);  // a call's result is moved in
+		else if (d.expr > -1)                        c_expr(d.expr),  emit(Op::dim_clone, typeid_(d.type));
+		else                                         emit(Op::dim_make, typeid_(d.type));
+	}
+
+
+	// === statements ===
+
+	void c_block(int32_t bptr) {
+		const auto& bl = prog.blocks.at(bptr);
+		for (auto& st : bl.statements) {
+			if (profile)  emit(Op::line, st.dsym.lno, st.dsym.fno);
+			switch (st.type) {
+			// I/O
+			case Stmt::print:      c_print(st.loc);  break;
+			case Stmt::input:      c_input(st.loc);  break;
+			// control blocks
+			case Stmt::if_:        c_if(st.loc);  break;
+			case Stmt::while_:     c_while(st.loc);  break;
+			case Stmt::for_:       c_for(st.loc);  break;
+			// control
+			case Stmt::return_:    c_return(st.loc);  break;
+			case Stmt::break_:     loops.at(loops.size() - st.loc).breaks.push_back( emit(Op::jmp) );  break;
+			case Stmt::continue_:  loops.at(loops.size() - st.loc).conts.push_back( emit(Op::jmp) );   break;
+			// expressions
+			case Stmt::let:        c_let(st.loc);  break;
+			case Stmt::call:       c_call(st.loc),  c_drop(prog.calls.at(st.loc).type);  break;
+			default:  throw runtime_error(string("compile: unknown statement: ") + stmtname(st.type));
+			}
+		}
+	}
+
+	void c_print(int32_t prp) {
+		for (auto& in : prog.prints.at(prp).instr)
+			switch (in.cmd) {
+			case Cmd::literal:   emit(Op::print_lit, in.iarg);  break;
+			case Cmd::expr:      c_expr(in.iarg),  emit(Op::print_int);  break;
+			case Cmd::expr_str:  c_expr(in.iarg),  emit(Op::print_str);  break;
+			default:  throw runtime_error(string("compile: unknown print: ") + cmdname(in.cmd));
+			}
+		emit(Op::print_nl);
+	}
+
+	void c_input(int32_t inp) {
+		c_varpath(prog.inputs.at(inp).varpath, 1);
+		emit(Op::input, inp);
+	}
+
+	void c_if(int32_t ifp) {
+		vector<int32_t> ends;
+		for (auto& cond : prog.ifs.at(ifp).conds)
+			if (cond.expr == -1)
+				c_block(cond.block);  // else: always run
+			else {
+				c_expr(cond.expr);
+				int32_t next = emit(Op::jz);
+				c_block(cond.block);
+				ends.push_back( emit(Op::jmp) );
+				patch(next, here());
+			}
+		patch(ends, here());
+	}
+
+	void c_while(int32_t whp) {
+		const auto& wh = prog.whiles.at(whp);
+		int32_t top = here();
+		c_expr(wh.expr);
+		int32_t exit = emit(Op::jz);
+		loops.push_back({ });
+		c_block(wh.block);
+		emit(Op::jmp, top);
+		patch(exit, here());
+		patch(loops.back().breaks, here());
+		patch(loops.back().conts, top);
+		loops.pop_back();
+	}
+
+	void c_for(int32_t fop) {
+		const auto& fo = prog.fors.at(fop);
+		// start
+		c_expr(fo.start_expr),  c_varpath(fo.varpath, 1),  emit(Op::store);
+		// condition
+		int32_t top = here();
+		c_varpath(fo.varpath),  emit(Op::load),  c_expr(fo.end_expr);
+		emit(fo.step >= 0 ? Op::gt : Op::lt);
+		int32_t exit = emit(Op::jnz);
+		// block
+		loops.push_back({ });
+		c_block(fo.block);
+		// step
+		int32_t step = here();
+		c_varpath(fo.varpath, 1),  emit(Op::inc, fo.step);
+		emit(Op::jmp, top);
+		patch(exit, here());
+		patch(loops.back().breaks, here());
+		patch(loops.back().conts, step);
+		loops.pop_back();
+	}
+
+	void c_return(int32_t exp) {
+		if (exp == -1) {
+			emit(Op::i, 0),  emit(Op::ret, cfunc);  // default return value
+			return;
+		}
+		const auto& ex = prog.exprs.at(exp);
+		c_expr(exp);
+		if      (ex.type == "int" || ex.temp())  emit(Op::ret, cfunc);
+		else if (ex.type == "string")            emit(Op::ret_str, cfunc);
+		else                                     emit(Op::ret_obj, cfunc);
+	}
+
+	void c_let(int32_t letp) {
+		const auto& l = prog.lets.at(letp);
+		if (l.append) {
+			c_expr(l.expr),  c_varpath(l.varpath, 1),  emit(Op::append_str);
+			return;
+		}
+		int32_t n = c_index(l.varpath);  // the path's indexes, then the value, then the path, as in Runtime::let
+		c_expr(l.expr);
+		c_varpath(l.varpath, 1, n ? n + 1 : 0);
+		if      (l.type == "int")                emit(Op::store);
+		else if (l.type == "string")             emit(Op::store_str);
+		else if (prog.exprs.at(l.expr).temp())  emit(Op::store_move);  // a call's result
+		else                                     emit(Op::store_obj);
+		for (int32_t i = 0; i < n; i++)  emit(Op::pop);
+	}
+
+
+	// === calls ===
+
+	void c_call(int32_t cap) {
+		const auto& ca = prog.calls.at(cap);
+		// user function. arguments are left on the stacks in order
+		if (ca.func > -1) {
+			int32_t held = 0,  pinned = pins;
+			for (auto& arg : ca.args) {
+				c_expr(arg.expr, 2);  // objects by reference: the callee may write them
+				if (prog.exprs.at(arg.expr).temp())  emit(Op::hold),  held++;
+			}
+			pinned = pins - pinned;
+			if (census)  emit(Op::site, ca.dsym.lno, ca.dsym.fno);
+			emit(Op::call, ca.func, -1);  // target resolved once all functions are compiled
+			if (held)    emit(Op::unhold, held);
+			if (pinned)  emit(Op::unpin, pinned),  pins -= pinned;
+			return;
+		}
+		// system functions
+		switch (ca.sys) {
+		case Sys::push: {
+			// the array first, as in Runtime::call_sys. a path's indexes stay below the value, a call's result too (n = -1)
+			auto&   av = ca.args.at(1);
+			auto&   ar = prog.exprs.at(ca.args.at(0).expr).instr;
+			int32_t n  = -1;
+			if (ar.size() == 1 && ar[0].cmd == Cmd::varpath_ptr)
+				n = c_index(ar[0].iarg),  c_expr(av.expr),  c_varpath(ar[0].iarg, 1, n ? n + 1 : 0),  emit(Op::load);
+			else
+				c_expr(ca.args.at(0).expr, 1),  c_expr(av.expr);
+			c_sysop(ca.sys, Op::sys_push, av.type == "int" || prog.exprs.at(av.expr).temp() ? 0 : av.type == "string" ? 1 : 2, n);
+			break;
+		}
+		case Sys::pop:       c_expr(ca.args.at(0).expr, 1),  c_sysop(ca.sys, Op::sys_pop, ca.args.at(0).type != "int[]");  break;
+		case Sys::len: {
+			auto& av = ca.args.at(0);
+			c_expr(av.expr);
+			if      (av.type == "string")            c_sysop(ca.sys, Op::sys_len_str);
+			else if (prog.exprs.at(av.expr).temp())  emit(Op::hold),  c_sysop(ca.sys, Op::sys_len),  emit(Op::unhold, 1);
+			else                                     c_sysop(ca.sys, Op::sys_len);
+			break;
+		}
+		case Sys::default_:  c_expr(ca.args.at(0).expr, 1),  c_sysop(ca.sys, Op::sys_default);  break;
+		default:  throw runtime_error("compile: unknown function: " + ca.fname);
+		}
+	}
+	// a system call's op, once its arguments are on the stack. len is not traced (Runtime::call_system)
+	void c_sysop(Sys sys, Op op, int32_t a=0, int32_t b=0) {
+		int t = trace && sys != Sys::len;
+		if (t)  emit(Op::trace_sys, (int32_t)sys);
+		emit(op, a, b);
+		if (t)  emit(Op::trace_end);
+	}
+
+
+	// discard a call statement's result
+	void c_drop(const string& type) {
+		if      (type == "int")     emit(Op::pop);
+		else if (type == "string")  emit(Op::pop_str);
+		else                        emit(Op::pop_obj);
+	}
+
+
+	// === expressions ===
+
+	// write: the path is written through, so it uses the _w references that copy shared pages.
+	// write 2: the pages are pinned too (Runtime::varpath). at: the indexes are on the stack already
+	// (c_index), the first one at slot at from the top
+	void c_varpath(int32_t vpp, int write=0, int32_t at=0) {
+		for (auto& in : prog.varpaths.at(vpp).instr)
+			switch (in.cmd) {
+			case Cmd::get:          emit(Op::ref_local, in.iarg);  break;
+			case Cmd::get_global:   emit(Op::ref_global, in.iarg);  break;
+			case Cmd::memget_expr:  if (write == 2)  emit(Op::pin),  pins++;
+			                        if    (at)  emit(Op::ref_index_at, at--);
+			                        else  c_expr(in.iarg),  emit(write ? Op::ref_index_w : Op::ref_index);
+			                        break;
+			case Cmd::memget_prop:  if (write == 2)  emit(Op::pin),  pins++;
+			                        emit(write ? Op::ref_prop_w : Op::ref_prop, in.iarg);  break;
+			case Cmd::memget_chr:   if    (at)  emit(Op::ref_chr_at, at--);
+			                        else  c_expr(in.iarg),  emit(write ? Op::ref_chr_w : Op::ref_chr);
+			                        break;
+			default:  throw runtime_error(string("compile: unknown varpath: ") + cmdname(in.cmd));
+			}
+	}
+	// a write path's index expressions, in path order. returns how many
+	int32_t c_index(int32_t vpp) {
+		int32_t n = 0;
+		for (auto& in : prog.varpaths.at(vpp).instr)
+			if (in.cmd == Cmd::memget_expr || in.cmd == Cmd::memget_chr)  c_expr(in.iarg),  n++;
+		return n;
+	}
+
+	void c_expr(int32_t exp, int write=0) {
+		for (auto& in : prog.exprs.at(exp).instr)
+			switch (in.cmd) {
+			// integers
+			case Cmd::i:            emit(Op::i, in.iarg);  break;
+			case Cmd::varpath:      c_varpath(in.iarg),  emit(Op::load);  break;
+			case Cmd::add:          emit(Op::add);  break;
+			case Cmd::sub:          emit(Op::sub);  break;
+			case Cmd::mul:          emit(Op::mul);  break;
+			case Cmd::div:          emit(Op::div);  break;
+			case Cmd::and_:         emit(Op::and_);  break;
+			case Cmd::or_:          emit(Op::or_);  break;
+			case Cmd::eq:           emit(Op::eq);  break;
+			case Cmd::neq:          emit(Op::neq);  break;
+			case Cmd::lt:           emit(Op::lt);  break;
+			case Cmd::gt:           emit(Op::gt);  break;
+			case Cmd::lte:          emit(Op::lte);  break;
+			case Cmd::gte:          emit(Op::gte);  break;
+			// strings
+			case Cmd::lit:          emit(Op::lit, in.iarg);  break;
+			case Cmd::varpath_str:  c_varpath(in.iarg),  emit(Op::load_str);  break;
+			case Cmd::strcat:       emit(Op::strcat);  break;
+			case Cmd::eq_str:       emit(Op::eq_str);  break;
+			case Cmd::neq_str:      emit(Op::neq_str);  break;
+			// other
+			case Cmd::varpath_ptr:  c_varpath(in.iarg, write),  emit(Op::load);  break;
+			case Cmd::call:         c_call(in.iarg);  break;
+			default:  throw runtime_error(string("compile: unknown expr: ") + cmdname(in.cmd));
+			}
+	}
+
+
+
+	// === superinstructions ===
+
+	static Op fuse_pair(Op a, Op b) {
+		if (a == Op::ref_local  && b == Op::load)  return Op::load_local;
+		if (a == Op::ref_global && b == Op::load)  return Op::load_global;
+		if (a == Op::ref_local  && b == Op::inc)   return Op::inc_local;
+		if (a == Op::i && b == Op::add)            return Op::add_i;
+		if (a == Op::i && b == Op::sub)            return Op::sub_i;
+		if (b == Op::jz)
+			switch (a) {
+			case Op::eq:   return Op::jz_eq;
+			case Op::neq:  return Op::jz_neq;
+			case Op::lt:   return Op::jz_lt;
+			case Op::gt:   return Op::jz_gt;
+			case Op::lte:  return Op::jz_lte;
+			case Op::gte:  return Op::jz_gte;
+			default:       break;
+			}
+		if (b == Op::jnz && a == Op::lt)           return Op::jnz_lt;
+		if (b == Op::jnz && a == Op::gt)           return Op::jnz_gt;
+		return Op::noop;
+	}
+
+	// peephole pass: replace common pairs with one instruction, then remap jump targets.
+	// a pair is left alone if anything jumps to its second half
+	void fuse() {
+		const auto& code = bc.code;
+		vector<char> target(code.size() + 1, 0);
+		for (auto& in : code)
+			if      (is_jump(in.op))     target.at(in.a) = 1;
+			else if (in.op == Op::call)  target.at(in.b) = 1;
+		vector<Bytecode::Instr> out;
+		vector<int32_t> remap(code.size() + 1, 0);
+		for (size_t pc = 0; pc < code.size(); pc++) {
+			remap[pc] = out.size();
+			Op op = pc + 1 < code.size() && !target[pc + 1] ? fuse_pair(code[pc].op, code[pc + 1].op) : Op::noop;
+			if      (op == Op::noop)  out.push_back(code[pc]);
+			else if (is_jump(op))     out.push_back({ op, code[pc + 1].a, 0 }),  remap[++pc] = out.size() - 1;
+			else                      out.push_back({ op, code[pc].a, code[pc + 1].a }),  remap[++pc] = out.size() - 1;
+		}
+		remap[code.size()] = out.size();
+		for (auto& in : out)
+			if      (is_jump(in.op))     in.a = remap[in.a];
+			else if (in.op == Op::call)  in.b = remap[in.b];
+		for (auto& e : bc.entry)
+			e = remap.at(e);
+		bc.code = out;
+	}
+
+};  // end Compiler
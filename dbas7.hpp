@@ -1,117 +1,238 @@
 #pragma once
 #include <vector>
-#include <list>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <stdexcept>
 using namespace std;
 
 
-// TODO: this is a bad idea in general
-template <typename T>
-class dlist : public list<T> {
+// chunked vector: O(1) indexing, and references stay valid across push_back (unlike std::vector),
+// so the parser can hold a node while it appends its children to the same table
+template <typename T, int CHUNK_BITS=8>
+class dvec {
+private:
+	static const size_t CHUNK = size_t(1) << CHUNK_BITS;
+	vector<vector<T>> chunks;
+	size_t count = 0;
+
+	template <typename D, typename V>
+	struct iter {
+		D* d;  size_t i;
+		V&    operator* () const { return (*d)[i]; }
+		V*    operator->() const { return &(*d)[i]; }
+		iter& operator++()       { return i++, *this; }
+		bool  operator!=(const iter& it) const { return i != it.i; }
+		bool  operator==(const iter& it) const { return i == it.i; }
+	};
+
 public:
-	using list<T>::list;
+	typedef  iter<dvec, T>              iterator;
+	typedef  iter<const dvec, const T>  const_iterator;
+
+	dvec() = default;
+	dvec(const dvec& d) { *this = d; }
+	dvec(dvec&& d) = default;
+	dvec& operator=(dvec&& d) = default;
+	dvec& operator=(const dvec& d) {
+		// rebuild rather than copy, so every chunk keeps its full reserved capacity
+		if (this == &d)  return *this;
+		clear();
+		for (const auto& el : d)  push_back(el);
+		return *this;
+	}
+
+	size_t size () const { return count; }
+	int    empty() const { return count == 0; }
+	void   clear()       { chunks = {},  count = 0; }
+	void push_back(const T& el) {
+		if (count % CHUNK == 0)
+			chunks.emplace_back(),  chunks.back().reserve(CHUNK);
+		chunks.back().push_back(el),  count++;
+	}
+	void push_back(T&& el) {
+		if (count % CHUNK == 0)
+			chunks.emplace_back(),  chunks.back().reserve(CHUNK);
+		chunks.back().push_back(move(el)),  count++;
+	}
+
 	T&       at        (int i)       { return (T&)find(i); }
-	T&       operator[](int i)       { return (T&)find(i); }
+	T&       operator[](int i)       { return chunks[i >> CHUNK_BITS][i & (CHUNK-1)]; }
 	const T& at        (int i) const { return find(i); }
-	const T& operator[](int i) const { return find(i); }
+	const T& operator[](int i) const { return chunks[i >> CHUNK_BITS][i & (CHUNK-1)]; }
 	const T& find(int i) const {
-		if (i < 0 || i >= this->size())
-			throw out_of_range(string("dlist out of range: ") + to_string(i));
-		auto it = this->begin();
-		advance(it, i);
-		return *it;
+		if (i < 0 || i >= count)
+			throw out_of_range(string("dvec out of range: ") + to_string(i));
+		return (*this)[i];
+	}
+	T&       back()       { return chunks.back().back(); }
+	const T& back() const { return chunks.back().back(); }
+
+	iterator       begin()       { return { this, 0 }; }
+	iterator       end  ()       { return { this, count }; }
+	const_iterator begin() const { return { this, 0 }; }
+	const_iterator end  () const { return { this, count }; }
+};
+
+
+// interned string literals, stored back to back in one arena. ids are stable, and views
+// from at() stay valid once parsing is done (the arena only grows while interning)
+class LiteralPool {
+private:
+	struct Span { int32_t off, len; };
+	string                              arena;
+	vector<Span>                        spans;  // by id
+	unordered_multimap<size_t, int32_t> index;  // hash -> ids
+public:
+	int32_t intern(string_view s) {
+		size_t h = hash<string_view>()(s);
+		for (auto r = index.equal_range(h); r.first != r.second; r.first++)
+			if (at(r.first->second) == s)  return r.first->second;
+		spans.push_back({ (int32_t)arena.size(), (int32_t)s.size() });
+		arena.append(s);
+		index.emplace(h, spans.size() - 1);
+		return spans.size() - 1;
+	}
+	string_view at(size_t id) const {
+		const Span& sp = spans.at(id);
+		return { arena.data() + sp.off, (size_t)sp.len };
 	}
+	string_view operator[](size_t id) const { return { arena.data() + spans[id].off, (size_t)spans[id].len }; }
+	size_t size()  const { return spans.size(); }
+	size_t bytes() const { return arena.size(); }
+};
+
+
+// instruction opcodes. numbered densely so that dispatch switches compile to a jump table
+enum class Cmd : int32_t {
+	noop = 0,
+	// integers
+	i,
+	varpath,
+	add,
+	sub,
+	mul,
+	div,
+	and_,
+	or_,
+	eq,
+	neq,
+	lt,
+	gt,
+	lte,
+	gte,
+	// strings
+	lit,
+	varpath_str,
+	strcat,
+	eq_str,
+	neq_str,
+	// memory
+	get,
+	get_global,
+	memget_expr,
+	memget_prop,
+	memget_chr,
+	// other
+	varpath_ptr,
+	call,
+	// print
+	literal,
+	expr,
+	expr_str,
+	CMD_COUNT
 };
 
+const char* cmdname(Cmd cmd) {
+	static const char* NAMES[] = {
+		"noop",
+		"i", "varpath", "add", "sub", "mul", "div", "and", "or", "eq", "neq", "lt", "gt", "lte", "gte",
+		"lit", "varpath_str", "strcat", "eq_str", "neq_str",
+		"get", "get_global", "memget_expr", "memget_prop", "memget_chr",
+		"varpath_ptr", "call",
+		"literal", "expr", "expr_str" };
+	static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == (size_t)Cmd::CMD_COUNT, "cmdname table out of sync with Cmd");
+	return cmd >= Cmd::noop && cmd < Cmd::CMD_COUNT ? NAMES[(int)cmd] : "<BAD_CMD>";
+}
 
-// template <typename T>
-// class dvec {
-// private:
-// 	vector<T*> v;
-// 	void destroyall() { for (T* el : v) delete el; }
-// public:
-// 	dvec(const dvec& d) {
-// 		destroyall();
-// 		v.resize(d.size(), nullptr);
-// 		for (int i = 0; i < d.size(); i++)
-// 			v[i] = new T(*d.v[i]);
-// 	}
-// 	~dvec() { destroyall(); }
-// 	int size() { return v.size(); }
-// 	int length() { return v.size(); }
-// };
-
-
-// enum class Cmd {
-// 	// integers
-// 	i = 1,
-// 	varpath,
-// 	add,
-// 	sub,
-// 	mul,
-// 	div,
-// 	and_,
-// 	or_,
-// 	eq,
-// 	neq,
-// 	lt,
-// 	gt,
-// 	lte,
-// 	gte,
-// 	// strings
-// 	lit = 20,
-// 	varpath_str,
-// 	strcat,
-// 	eq_str,
-// 	neq_str,
-// 	// memory
-// 	get = 30,
-// 	get_global,
-// 	memget_expr,
-// 	memget_prop,
-// 	// other
-// 	varpath_ptr = 40,
-// 	call,
-// };
+
+// block statement kinds, resolved at parse time
+enum class Stmt : int32_t {
+	noop = 0,
+	// I/O
+	print,
+	input,
+	// control blocks
+	if_,
+	while_,
+	for_,
+	// control
+	return_,
+	break_,
+	continue_,
+	// expressions
+	let,
+	call,
+	STMT_COUNT
+};
+
+const char* stmtname(Stmt type) {
+	static const char* NAMES[] = {
+		"noop", "print", "input", "if", "while", "for", "return", "break", "continue", "let", "call" };
+	static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == (size_t)Stmt::STMT_COUNT, "stmtname table out of sync with Stmt");
+	return type >= Stmt::noop && type < Stmt::STMT_COUNT ? NAMES[(int)type] : "<BAD_STMT>";
+}
+
+
+// system (magic) functions, resolved at link time
+enum class Sys : int32_t {
+	none = 0,
+	push,
+	pop,
+	len,
+	default_,
+};
 
 
 struct Prog {
 	struct Dsym         { int lno, fno; };
 	struct Dim          { string name, type; int expr; Dsym dsym; };
 	struct Type         { string name; vector<Dim> members; };
-	struct Function     { string name; int block; vector<Dim> args, locals; Dsym dsym; };
-	struct Statement    { string type; int loc; };
+	struct Function     { string name; int block; vector<Dim> args, locals; Dsym dsym; string type = "int"; };  // type: of the return value
+	struct Statement    { Stmt type; int loc; Dsym dsym; };
 	struct Block        { vector<Statement> statements; };
-	struct Instruction  { string cmd; int32_t iarg; string sarg; };
+	struct Instruction  { Cmd cmd; int32_t iarg; string sarg; };
 	struct Print        { vector<Instruction> instr; };
 	struct Input        { string prompt; int varpath; };
 	struct Condition    { int expr; int block; };
 	struct If           { vector<Condition> conds; };
 	struct While        { int expr; int block; };
 	struct For          { int varpath; int start_expr; int end_expr; int32_t step; int block; };
-	struct Let          { string type; int varpath, expr; };
+	struct Let          { string type; int varpath, expr; int append = 0; };  // append: s = s + expr, expr is the tail
 	struct VarPath      { string type; vector<Instruction> instr; };
-	struct Expr         { string type; vector<Instruction> instr; };
+	struct Expr         { string type; vector<Instruction> instr;
+		// an object or array returned by a call. the expression owns it, where a variable's value is only borrowed
+		int temp() const { return instr.size() == 1 && instr[0].cmd == Cmd::call && type != "int" && type != "string"; }
+	};
 	struct Argument     { string type; int expr; };
-	struct Call         { string fname; vector<Argument> args; Dsym dsym; };
+	struct Call         { string fname; vector<Argument> args; Dsym dsym; int32_t func = -1; Sys sys = Sys::none; string type = "int"; };  // func / sys: set by Parser::p_link
 
 	string                   module;
 	vector<string>           files;
-	dlist<Prog::Type>        types;
-	dlist<Prog::Dim>         globals;
-	dlist<Prog::Function>    functions;
-	dlist<string>            literals;  // temp?
-	dlist<Prog::Block>       blocks;
-	dlist<Prog::Print>       prints;
-	dlist<Prog::Input>       inputs;
-	dlist<Prog::If>          ifs;
-	dlist<Prog::While>       whiles;
-	dlist<Prog::For>         fors;
-	dlist<Prog::Let>         lets;
-	dlist<Prog::VarPath>     varpaths;
-	dlist<Prog::Expr>        exprs;
-	dlist<Prog::Call>        calls;
+	dvec<Prog::Type>        types;
+	dvec<Prog::Dim>         globals;
+	dvec<Prog::Function>    functions;
+	LiteralPool             literals;
+	dvec<Prog::Block>       blocks;
+	dvec<Prog::Print>       prints;
+	dvec<Prog::Input>       inputs;
+	dvec<Prog::If>          ifs;
+	dvec<Prog::While>       whiles;
+	dvec<Prog::For>         fors;
+	dvec<Prog::Let>         lets;
+	dvec<Prog::VarPath>     varpaths;
+	dvec<Prog::Expr>        exprs;
+	dvec<Prog::Call>        calls;
 };
 
 
@@ -81,9 +81,9 @@ struct Progshow {
 			output("", 0),  show_function(fn, 0);
 	}
 
-	void show_literal      (int sp, int id) { output("\"" + prog.literals.at(sp) + "\"", id); }
-	void show_literal_head (int sp, int id) { output("lit \"" + prog.literals.at(sp) + "\"", id); }
-	void show_literal_index(int sp, int id) { output(numfmt(sp, 2) + " \"" + prog.literals.at(sp) + "\"", id); }
+	void show_literal      (int sp, int id) { output("\"" + string(prog.literals.at(sp)) + "\"", id); }
+	void show_literal_head (int sp, int id) { output("lit \"" + string(prog.literals.at(sp)) + "\"", id); }
+	void show_literal_index(int sp, int id) { output(numfmt(sp, 2) + " \"" + string(prog.literals.at(sp)) + "\"", id); }
 
 	void show_dim(const Prog::Dim& d, int id) {
 		output(d.type + "  " + d.name, id);
@@ -98,7 +98,7 @@ struct Progshow {
 	}
 
 	void show_function(const Prog::Function& fn, int id) {
-		output("function " + fn.name, id);
+		output("function " + (fn.type == "int" ? "" : fn.type + " ") + fn.name, id);
 		output("args", id+1);
 		for (auto& d : fn.args)
 			show_dim(d, id+2);
@@ -112,26 +112,28 @@ struct Progshow {
 		const auto& bl = prog.blocks.at(blp);
 		output("block", id);
 		for (auto& st : bl.statements)
-			if      (st.type == "print")     show_print (st.loc, id);
-			else if (st.type == "if")        show_if    (st.loc, id);
-			else if (st.type == "while")     show_while (st.loc, id);
-			else if (st.type == "return")    show_return(st.loc, id);
-			else if (st.type == "break")     output("break " + to_string(st.loc), id);
-			else if (st.type == "continue")  output("continue " + to_string(st.loc), id);
-			else if (st.type == "let")       show_let   (st.loc, id);
-			else if (st.type == "call")      show_call  (st.loc, id);
-			else    output("?? (" + st.type + ")", id);
+			switch (st.type) {
+			case Stmt::print:      show_print (st.loc, id);  break;
+			case Stmt::if_:        show_if    (st.loc, id);  break;
+			case Stmt::while_:     show_while (st.loc, id);  break;
+			case Stmt::return_:    show_return(st.loc, id);  break;
+			case Stmt::break_:     output("break " + to_string(st.loc), id);  break;
+			case Stmt::continue_:  output("continue " + to_string(st.loc), id);  break;
+			case Stmt::let:        show_let   (st.loc, id);  break;
+			case Stmt::call:       show_call  (st.loc, id);  break;
+			default:  output(string("?? (") + stmtname(st.type) + ")", id);
+			}
 	}
 
 	void show_print(int prp, int id) {
 		const auto& pr = prog.prints.at(prp);
 		output("print", id);
 		for (auto& in : pr.instr) {
-			output(in.cmd, id+1);
-			if      (in.cmd == "literal")   show_literal(in.iarg, id+2);
-			else if (in.cmd == "expr")      show_expr   (in.iarg, id+2);
-			else if (in.cmd == "expr_str")  show_expr   (in.iarg, id+2);
-			else    output("?? (" + in.cmd + ")", id+2);
+			output(cmdname(in.cmd), id+1);
+			if      (in.cmd == Cmd::literal)   show_literal(in.iarg, id+2);
+			else if (in.cmd == Cmd::expr)      show_expr   (in.iarg, id+2);
+			else if (in.cmd == Cmd::expr_str)  show_expr   (in.iarg, id+2);
+			else    output(string("?? (") + cmdname(in.cmd) + ")", id+2);
 		}
 	}
 
@@ -161,7 +163,7 @@ struct Progshow {
 
 	void show_let(int lp, int id) {
 		const auto& l = prog.lets.at(lp);
-		output           ("let", id);
+		output           (l.append ? "let (append)" : "let", id);
 		show_varpath_head(l.varpath, id+1);
 		show_expr_head   (l.expr, id+1);
 	}
@@ -181,13 +183,13 @@ struct Progshow {
 	void show_varpath(int vpp, int id) {
 		const auto& vp = prog.varpaths.at(vpp);
 		for (auto& in : vp.instr)
-			if (in.cmd == "get" || in.cmd == "get_global" || in.cmd == "memget_prop")
-				output(in.cmd + " " + in.sarg, id);
-			else if (in.cmd == "memget_expr")
-				output   (in.cmd, id),
+			if (in.cmd == Cmd::get || in.cmd == Cmd::get_global || in.cmd == Cmd::memget_prop)
+				output(cmdname(in.cmd) + string(" ") + in.sarg + " (" + to_string(in.iarg) + ")", id);
+			else if (in.cmd == Cmd::memget_expr || in.cmd == Cmd::memget_chr)
+				output   (cmdname(in.cmd), id),
 				show_expr(in.iarg, id+1);
 			else
-				output("?? (" + in.cmd + ")", id);
+				output(string("?? (") + cmdname(in.cmd) + ")", id);
 	}
 
 	void show_expr_head(int exp, int id) {
@@ -198,20 +200,18 @@ struct Progshow {
 	void show_expr(int exp, int id) {
 		const auto& ex = prog.exprs.at(exp);
 		for (auto& in : ex.instr)
-			if      (in.cmd == "i")
+			if      (in.cmd == Cmd::i)
 				output("i " + to_string(in.iarg), id);
-			else if (in.cmd == "lit")
+			else if (in.cmd == Cmd::lit)
 				show_literal_head(in.iarg, id);
-			else if (in.cmd == "varpath" || in.cmd == "varpath_str")
-				output(in.cmd, id),  show_varpath(in.iarg, id);
-			else if (in.cmd == "varpath_ptr")
+			else if (in.cmd == Cmd::varpath || in.cmd == Cmd::varpath_str)
+				output(cmdname(in.cmd), id),  show_varpath(in.iarg, id);
+			else if (in.cmd == Cmd::varpath_ptr)
 				show_varpath_head(in.iarg, id);
-			else if (in.cmd == "call")
+			else if (in.cmd == Cmd::call)
 				show_call(in.iarg, id);
-			else if (in.cmd == "add" || in.cmd == "sub" || in.cmd == "eq" || in.cmd == "neq" || in.cmd == "strcat")
-				output(in.cmd, id);
 			else
-				output("?? (" + in.cmd + ")", id);
+				output(cmdname(in.cmd), id);
 	}
 
 };
\ No newline at end of file
@@ -0,0 +1,206 @@
+// ----------------------------------------
+// Runtime heap
+// ----------------------------------------
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include "dbas7.hpp"
+using namespace std;
+
+
+// Pages live in slabs (dvec chunks), one pool per kind of page, and freed slots
+// are reused. Handles are not: every page made gets the next handle, and a table
+// maps handles to slots, so translation is two indexes, and a handle kept after
+// its page was destroyed is always caught. Table chunks whose handles are all
+// dead are released, so a program that makes and drops pages keeps the table
+// small. Up to 2^31 - 1 pages can be made in a run, any number of them live.
+// A page's contents live in a reference counted body. Copying a page (share)
+// makes a new handle on the same body; the body is only duplicated once one of
+// the sharing pages is written to (unshare), so copies stay cheap until then.
+struct Heap {
+	struct MemPage { string type; vector<int32_t> mem; string str; };  // str: byte contents of string pages
+	struct Body    { MemPage page; int32_t refs; };
+	struct Slot    { Body* body; int64_t serial; int32_t index, site, pins; uint8_t pool, live; };  // site, serial: where and when the page was made (Census). pins: see pin()
+	struct Pool    { dvec<Slot, 10> slots; vector<int32_t> freelist; };
+	struct Stats   { int32_t live, free, total; };
+	struct Count   { int64_t allocs, frees, shares, unshares, copied; };  // copied: bytes, by unshare
+	enum PoolType  { POOL_STRING = 1, POOL_ARRAY, POOL_OBJECT, POOL_COUNT };
+
+	// handle table: handle -> slot, NULL once the page is destroyed. handles start at 1
+	static const int32_t HCHUNK_BITS = 10,  HCHUNK = 1 << HCHUNK_BITS;
+	vector<unique_ptr<Slot*[]>>  htable;  // by handle >> HCHUNK_BITS. released once all its handles are dead
+	vector<int32_t>              hlive;   // live handles per chunk
+	int32_t                      htop = 0;  // last handle given out
+
+	Pool pools[POOL_COUNT];
+	dvec<Body, 10>  bodies;
+	vector<Body*>   freebodies;
+	int32_t livecount = 0;
+	int32_t unshares  = 0;  // bodies duplicated on write
+	int32_t peak      = 0;  // most live pages at once
+	int64_t serial    = 0;  // pages made so far
+	// accounting by site, while track is set. the Census keeps site pointed at the running call
+	int            track = 0;
+	int32_t        site  = 0;
+	vector<Count>  counts;  // by site
+
+
+	// handles
+	static int32_t pooltype(const string& type) {
+		if      (type == "string")            return POOL_STRING;
+		else if (Tokens::is_arraytype(type))  return POOL_ARRAY;
+		else                                  return POOL_OBJECT;
+	}
+
+	Slot& slot(int32_t h) { return (Slot&)((const Heap*)this)->slot(h); }
+	const Slot& slot(int32_t h) const {
+		if (h <= 0 || h > htop)
+			throw out_of_range("heap: invalid handle " + to_string(h));
+		auto& chunk = htable[h >> HCHUNK_BITS];
+		if (!chunk || !chunk[h & (HCHUNK - 1)])
+			throw out_of_range("heap: stale handle " + to_string(h));
+		return *chunk[h & (HCHUNK - 1)];
+	}
+	int32_t newhandle(Slot* sl) {
+		if (htop == INT32_MAX)  throw runtime_error("heap: out of handles");
+		int32_t h = ++htop,  c = h >> HCHUNK_BITS;
+		if (c == (int32_t)htable.size()) {
+			if (c > 0 && hlive[c - 1] == 0)  htable[c - 1].reset();  // filled up with every handle already dead
+			htable.emplace_back( new Slot*[HCHUNK]() ),  hlive.push_back(0);
+		}
+		htable[c][h & (HCHUNK - 1)] = sl,  hlive[c]++;
+		return h;
+	}
+	void freehandle(int32_t h) {
+		int32_t c = h >> HCHUNK_BITS;
+		htable[c][h & (HCHUNK - 1)] = NULL;
+		if (--hlive[c] == 0 && c < (htop >> HCHUNK_BITS))  htable[c].reset();  // full, and all dead
+	}
+
+
+	// bodies. dvec addresses are stable, so slots point at their body directly
+	Body* newbody() {
+		if (freebodies.empty())  return bodies.push_back({ {}, 1 }),  &bodies.back();
+		Body* b = freebodies.back();
+		freebodies.pop_back();
+		b->refs = 1;
+		return b;
+	}
+	void dropbody(Body* b) {
+		if (--b->refs > 0)  return;
+		b->page.mem.clear(),  b->page.str.clear();
+		if (b->page.mem.capacity() > 256)  b->page.mem.shrink_to_fit();  // don't hoard large buffers in free bodies
+		if (b->page.str.capacity() > 1024) b->page.str.shrink_to_fit();
+		freebodies.push_back(b);
+	}
+	int32_t newslot(const string& type, Body* body) {
+		int32_t pool  = pooltype(type);
+		auto&   p     = pools[pool];
+		int32_t index = 0;
+		if (p.freelist.size())
+			index = p.freelist.back(),  p.freelist.pop_back();
+		else
+			index = p.slots.size(),  p.slots.push_back({ NULL, 0, index, 0, 0, (uint8_t)pool, 0 });
+		auto& sl = p.slots[index];
+		sl.body = body,  sl.live = 1,  sl.site = site,  sl.pins = 0,  sl.serial = ++serial;
+		if (++livecount > peak)  peak = livecount;
+		return newhandle(&sl);
+	}
+
+
+	// api
+	size_t         size() const        { return livecount; }
+	static int64_t bytes(const MemPage& p) { return p.mem.size() * sizeof(int32_t) + p.str.size(); }
+	MemPage&       at(int32_t h)       { return slot(h).body->page; }
+	const MemPage& at(int32_t h) const { return slot(h).body->page; }
+	Body&          body(int32_t h)     { return *slot(h).body; }
+	int32_t alloc(const string& type, int32_t size) {
+		Body* b = newbody();
+		b->page.type = type,  b->page.mem.assign(size, 0);
+		if (track)  counts[site].allocs++;
+		return newslot(type, b);
+	}
+	void free(int32_t h) {
+		auto& sl = slot(h);
+		dropbody(sl.body);
+		sl.live = 0;
+		pools[sl.pool].freelist.push_back(sl.index);
+		freehandle(h);  // outstanding copies of h are stale from here on
+		livecount--;
+		if (track)  counts[site].frees++;
+	}
+	int valid(int32_t h) const {  // h is a live page. unlike slot(), doesn't throw
+		return h > 0 && h <= htop && htable[h >> HCHUNK_BITS] && htable[h >> HCHUNK_BITS][h & (HCHUNK - 1)];
+	}
+	// copy on write
+	int shared(int32_t h) const { return slot(h).body->refs > 1; }
+	int same(int32_t h, int32_t g) const { return slot(h).body == slot(g).body; }
+	int32_t share(int32_t h) {
+		Body* b = slot(h).body;
+		b->refs++;
+		if (track)  counts[site].shares++;
+		return newslot(b->page.type, b);
+	}
+	// point page h at the body of page g
+	void rebind(int32_t h, int32_t g) {
+		auto& sl = slot(h);
+		Body* b  = slot(g).body;
+		if (sl.body == b)  return;
+		b->refs++;
+		dropbody(sl.body);
+		sl.body = b;
+	}
+	// give page h its own copy of a shared body. handles in mem are copied as they are
+	MemPage& unshare(int32_t h) {
+		auto& sl = slot(h);
+		if (sl.body->refs <= 1)  return sl.body->page;
+		Body* b = newbody();
+		b->page = sl.body->page;
+		dropbody(sl.body);
+		sl.body = b;
+		unshares++;
+		if (track)  counts[site].unshares++,  counts[site].copied += bytes(b->page);
+		return b->page;
+	}
+	// a pinned page is being written through a reference to one of its children (Runtime::pin),
+	// so its copies must not share its body: the reference has to stay on this side of the copy
+	void pin(int32_t h)   { slot(h).pins++; }
+	void unpin(int32_t h) { if (valid(h))  slot(h).pins--; }  // the page may be gone by now
+	int  pinned(int32_t h) const { return slot(h).pins > 0; }
+	// give page h a new empty body, leaving the shared contents to the other pages
+	void detach(int32_t h) {
+		auto& sl = slot(h);
+		Body* b  = newbody();
+		b->page.type = sl.body->page.type;
+		dropbody(sl.body);
+		sl.body = b;
+	}
+
+
+	// stats
+	template <typename F>
+	void each(F f) const {  // f(slot) for every live page
+		for (int32_t pool = POOL_STRING; pool < POOL_COUNT; pool++)
+			for (size_t i = 0; i < pools[pool].slots.size(); i++)
+				if (pools[pool].slots[i].live)  f(pools[pool].slots[i]);
+	}
+	Stats stats(int32_t pool) const {
+		int32_t total = pools[pool].slots.size(),  free = pools[pool].freelist.size();
+		return { total - free, free, total };
+	}
+	void show() const {
+		static const char* NAMES[] = { "", "string", "array", "object" };
+		for (int32_t pool = POOL_STRING; pool < POOL_COUNT; pool++) {
+			auto st = stats(pool);
+			printf("    %-8s  live %d | free %d | slots %d | frag %.1f%%\n",
+				NAMES[pool], st.live, st.free, st.total, st.total ? 100.0 * st.free / st.total : 0.0 );
+		}
+		int32_t nbodies = bodies.size() - freebodies.size();
+		int32_t nchunks = 0;
+		for (auto& c : htable)  nchunks += c != nullptr;
+		printf("    bodies    live %d | shared pages %d | unshared on write %d | peak pages %d\n", nbodies, livecount - nbodies, unshares, peak );
+		printf("    handles   made %d | table chunks %d of %d\n", htop, nchunks, (int)htable.size() );
+	}
+};
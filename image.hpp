@@ -0,0 +1,224 @@
+// ----------------------------------------
+// Precompiled program image (.dbc)
+// ----------------------------------------
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include "dbas7.hpp"
+#include "inputfile.hpp"
+#include "compiler.hpp"
+using namespace std;
+
+
+// Compiled bytecode plus the parts of Prog the VM reads at runtime: literals, types, globals,
+// function frames, input prompts and source file names (for the profiler). Everything refers to everything else by index, so loading
+// is bulk copies with no pointer fix-up. An image is only used when its header matches the
+// current format, the build's instruction set, the compile flags, and a hash of the source,
+// its contents hash to the header's payload hash, and every index in the bytecode is in range.
+struct Image {
+	static const uint32_t VERSION = 4;
+	struct Header {
+		char     magic[4];
+		uint32_t version, opcount, instrsize, flags, reserved;
+		uint64_t srchash, payhash;  // payhash: everything after the header
+	};
+	static_assert(sizeof(Header) == 40, "image header must have no padding");
+
+	// FNV-1a
+	static uint64_t hash(string_view s) {
+		uint64_t h = 14695981039346656037ull;
+		for (unsigned char c : s)  h = (h ^ c) * 1099511628211ull;
+		return h;
+	}
+	// FNV-1a on 8-byte words, for the payload: a few times faster on large images
+	static uint64_t hashwords(string_view s) {
+		uint64_t h = 14695981039346656037ull,  w;
+		size_t   i = 0;
+		for ( ; i + 8 <= s.size(); i += 8)  memcpy(&w, s.data() + i, 8),  h = (h ^ w) * 1099511628211ull,  h ^= h >> 29;
+		for ( ; i < s.size(); i++)          h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+		return h;
+	}
+	static uint64_t hashfile(const string& fname) {
+		MappedFile m;
+		if (m.open(fname))  throw runtime_error("could not open file: " + fname);
+		return hash(m.view());
+	}
+	static uint64_t hashfiles(const vector<string>& fnames) {
+		string s;
+		for (auto& f : fnames)  s += f + ":" + to_string(hashfile(f)) + "\n";
+		return hash(s);
+	}
+	static Header header(uint64_t srchash, uint32_t flags) {
+		return { { 'D', 'B', 'C', '\0' }, VERSION, (uint32_t)Op::OP_COUNT, sizeof(Bytecode::Instr), flags, 0, srchash, 0 };
+	}
+
+
+	// === write ===
+
+	struct Writer {
+		string out;
+		template <typename T>  void put(const T& v)  { out.append((const char*)&v, sizeof(T)); }
+		void str(string_view s)  { put<int32_t>(s.size()),  out.append(s); }
+		void dims(const vector<Prog::Dim>& ds) {
+			put<int32_t>(ds.size());
+			for (auto& d : ds)  str(d.name),  str(d.type);
+		}
+	};
+
+	static int write(const string& fname, const Prog& prog, const Bytecode& bc, uint64_t srchash, uint32_t flags) {
+		Writer w;
+		w.put(header(srchash, flags));
+		w.str(prog.module);
+		w.put<int32_t>(prog.files.size());
+		for (auto& f : prog.files)  w.str(f);
+		// program tables
+		w.put<int32_t>(prog.literals.size());
+		for (size_t i = 0; i < prog.literals.size(); i++)  w.str(prog.literals[i]);
+		w.put<int32_t>(prog.types.size());
+		for (auto& t : prog.types)  w.str(t.name),  w.dims(t.members);
+		w.put<int32_t>(prog.globals.size());
+		for (auto& g : prog.globals)  w.str(g.name),  w.str(g.type);
+		w.put<int32_t>(prog.functions.size());
+		for (auto& fn : prog.functions)  w.str(fn.name),  w.str(fn.type),  w.put(fn.dsym),  w.dims(fn.args),  w.dims(fn.locals);
+		w.put<int32_t>(prog.inputs.size());
+		for (auto& in : prog.inputs)  w.str(in.prompt);
+		// bytecode
+		w.put<int32_t>(bc.types.size());
+		for (auto& t : bc.types)  w.str(t);
+		w.put<int32_t>(bc.entry.size());
+		w.out.append((const char*)bc.entry.data(), bc.entry.size() * sizeof(int32_t));
+		w.put<int32_t>(bc.code.size());
+		w.out.append((const char*)bc.code.data(), bc.code.size() * sizeof(Bytecode::Instr));
+		Header h = header(srchash, flags);
+		h.payhash = hashwords(string_view(w.out).substr(sizeof(Header)));
+		memcpy(&w.out[0], &h, sizeof(Header));
+		// save to a temporary file and rename it over the old image, so a run killed mid-write,
+		// or a full disk, never leaves a partial image in place
+		string tmp = fname + ".tmp";
+		FILE* f = fopen(tmp.c_str(), "wb");
+		if (!f)  return fprintf(stderr, "could not open file: %s\n", tmp.c_str()), 1;
+		int ok = fwrite(w.out.data(), 1, w.out.size(), f) == w.out.size();
+		ok = (fclose(f) == 0) && ok;
+		if (!ok || rename(tmp.c_str(), fname.c_str()) != 0)
+			return remove(tmp.c_str()),  fprintf(stderr, "could not write program image: %s\n", fname.c_str()), 1;
+		printf("wrote program image to: %s\n", fname.c_str());
+		return 0;
+	}
+
+
+	// === load ===
+
+	struct Reader {
+		string_view d;
+		size_t p = 0;
+		const char* take(size_t n) {
+			if (n > d.size() - p)  throw runtime_error("program image truncated");
+			return p += n,  d.data() + p - n;
+		}
+		template <typename T>  T get()  { T v;  memcpy(&v, take(sizeof(T)), sizeof(T));  return v; }
+		string_view str()  { int32_t n = get<int32_t>();  return { take(n), (size_t)n }; }
+		vector<Prog::Dim> dims() {
+			vector<Prog::Dim> ds( get<int32_t>() );
+			for (auto& d : ds)  d.name = str(),  d.type = str(),  d.expr = -1;
+			return ds;
+		}
+	};
+
+	// returns 1 if the image was loaded, 0 if it is missing, stale or damaged
+	static int load(const string& fname, Prog& prog, Bytecode& bc, uint64_t srchash, uint32_t flags) {
+		try {
+			return load_image(fname, prog, bc, srchash, flags);
+		}
+		catch (exception& e) {
+			fprintf(stderr, "ignoring program image %s: %s\n", fname.c_str(), e.what());
+			return prog = {},  bc = {},  0;
+		}
+	}
+	static int load_image(const string& fname, Prog& prog, Bytecode& bc, uint64_t srchash, uint32_t flags) {
+		MappedFile m;
+		if (m.open(fname) || m.size < sizeof(Header))  return 0;
+		Reader r{ m.view() };
+		Header h = r.get<Header>(),  want = header(srchash, flags);
+		want.payhash = h.payhash;
+		if (memcmp(&h, &want, sizeof(Header)) != 0)  return 0;
+		if (hashwords(r.d.substr(sizeof(Header))) != h.payhash)  throw runtime_error("payload hash mismatch");
+		// program tables
+		prog = {};
+		prog.module = r.str();
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  prog.files.push_back(string(r.str()));
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  prog.literals.intern(r.str());
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  prog.types.push_back({ string(r.str()) }),  prog.types.back().members = r.dims();
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  prog.globals.push_back({ string(r.str()), string(r.str()), -1 });
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++) {
+			prog.functions.push_back({ string(r.str()), -1 });
+			prog.functions.back().type   = r.str();
+			prog.functions.back().dsym   = r.get<Prog::Dsym>();
+			prog.functions.back().args   = r.dims();
+			prog.functions.back().locals = r.dims();
+		}
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  prog.inputs.push_back({ string(r.str()), -1 });
+		// bytecode
+		bc = {};
+		for (int32_t i = 0, n = r.get<int32_t>(); i < n; i++)  bc.types.push_back(string(r.str()));
+		size_t n = r.get<uint32_t>();
+		const char* d = r.take(n * sizeof(int32_t));
+		bc.entry.resize(n);
+		memcpy(bc.entry.data(), d, n * sizeof(int32_t));
+		n = r.get<uint32_t>();
+		d = r.take(n * sizeof(Bytecode::Instr));
+		bc.code.resize(n);
+		memcpy(bc.code.data(), d, n * sizeof(Bytecode::Instr));
+		if (r.p != r.d.size())  throw runtime_error("trailing bytes");
+		verify(prog, bc);
+		printf("loaded program image: %s\n", fname.c_str());
+		return 1;
+	}
+
+	// the VM indexes its tables with instruction operands unchecked, so check them all once here:
+	// opcodes, jump and call targets, function entries, and every table index
+	static void verify(const Prog& prog, const Bytecode& bc) {
+		size_t ncode = bc.code.size(),  nprops = 0;
+		auto in = [](int32_t v, size_t n) { return v >= 0 && (size_t)v < n; };
+		for (auto& t : prog.types)  nprops = max(nprops, t.members.size());
+		if (bc.entry.size() != prog.functions.size())  throw runtime_error("bad function entry table");
+		vector<int32_t> owner(ncode, -1);  // function starting at each pc
+		for (size_t f = 0; f < bc.entry.size(); f++)
+			if      (bc.entry[f] == -1)  continue;
+			else if (!in(bc.entry[f], ncode))  throw runtime_error("bad entry for function " + to_string(f));
+			else    owner[bc.entry[f]] = f;
+		size_t nlocals = 0;  // frame size of the function the pc is in. 0 in the startup code
+		for (size_t pc = 0; pc < ncode; pc++) {
+			auto& ins = bc.code[pc];
+			if (owner[pc] > -1)  nlocals = prog.functions[owner[pc]].args.size() + prog.functions[owner[pc]].locals.size();
+			int ok = 1;
+			switch (ins.op) {
+			case Op::lit:  case Op::print_lit:                         ok = in(ins.a, prog.literals.size());  break;
+			case Op::ref_local:  case Op::load_local:  case Op::inc_local:  ok = in(ins.a, nlocals);  break;
+			case Op::ref_global:  case Op::load_global:                ok = in(ins.a, prog.globals.size());  break;
+			case Op::ref_prop:  case Op::ref_prop_w:                   ok = in(ins.a, nprops);  break;
+			case Op::dim_make:  case Op::dim_clone:                    ok = in(ins.a, bc.types.size());  break;
+			case Op::ret_str:  case Op::ret_new:                       ok = in(ins.a, prog.functions.size());  break;
+			case Op::input:                                            ok = in(ins.a, prog.inputs.size());  break;
+			case Op::call:      ok = in(ins.a, prog.functions.size()) && ins.b > -1 && ins.b == bc.entry[ins.a];  break;
+			case Op::unhold:  case Op::unpin:                          ok = ins.a >= 0;  break;
+			case Op::ref_index_at:  case Op::ref_chr_at:               ok = ins.a >= 1;  break;
+			case Op::sys_push:  ok = ins.a >= 0 && ins.a <= 2 && ins.b >= -1;  break;
+			case Op::line:  case Op::site:  ok = ins.a >= 0 && in(ins.b, prog.files.size() + 1);  break;
+			case Op::jmp:  case Op::jz:  case Op::jnz:  case Op::jz_eq:  case Op::jz_neq:  case Op::jz_lt:  case Op::jz_gt:
+			case Op::jz_lte:  case Op::jz_gte:  case Op::jnz_lt:  case Op::jnz_gt:
+				ok = in(ins.a, ncode);  break;
+			default:            ok = ins.op >= Op::noop && ins.op < Op::OP_COUNT;  break;
+			}
+			if (!ok)  throw runtime_error("bad instruction at " + to_string(pc) + ": " + opname(ins.op));
+		}
+		// execution must not run off the end
+		Op last = ncode ? bc.code.back().op : Op::noop;
+		if (last != Op::halt && last != Op::jmp && last != Op::ret && last != Op::ret_str && last != Op::ret_obj && last != Op::ret_new)
+			throw runtime_error("code does not end in a jump or return");
+	}
+};
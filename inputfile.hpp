@@ -4,26 +4,81 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
+#include <deque>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// read-only memory map of a whole file
+struct MappedFile {
+	const char* data = NULL;
+	size_t      size = 0;
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& m) : data(m.data), size(m.size) { m.data = NULL, m.size = 0; }
+	~MappedFile() { close(); }
+
+	int open(const string& path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1)  return 1;
+		struct stat st = {};
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED)  data = (const char*)p,  size = st.st_size;
+		}
+		::close(fd);
+		return st.st_size > 0 && data == NULL;  // empty files map to nothing
+	}
+	void close() {
+		if (data)  munmap((void*)data, size);
+		data = NULL,  size = 0;
+	}
+	string_view view() const { return { data, size }; }
+};
 
 
 struct InputFile {
 	struct parse_error : runtime_error { using runtime_error::runtime_error; };
+	// token kinds, classified once by the lexer
+	enum TokKind : uint8_t { TK_OTHER = 0, TK_IDENTIFIER, TK_INTEGER, TK_LITERAL, TK_COMMENT, TK_SIGN };
+	struct Token { string_view text; uint8_t kind; };
+	// compiled rule: one part per space-separated word of the rule string
+	enum Pat { PAT_TOKEN = 0, PAT_EOF, PAT_EOL, PAT_ENDL, PAT_INTEGER, PAT_SIGN, PAT_IDENTIFIER, PAT_LITERAL };
+	struct RulePart { Pat pat; string tok; int save; };
+	typedef  vector<RulePart>  Rule;
 
 	string fname;
-	vector<string> lines, tokens;
+	// source, tokenized whole by lex(). tokens are views into the source
+	MappedFile          srcmap;
+	string              srcbuf;    // loadstring source
+	vector<string_view> lines;
+	vector<Token>       toks;
+	vector<int32_t>     linetok;   // index of each line's first token, plus one past the end
+	deque<string>       escaped;   // literals rewritten by escape handling, which views can't express
+	int                 lexerr_line = -1;
+	string              lexerr_msg;
+	// parse position. the current line's tokens are toks[tbase, tend)
 	string lasttok;
-	vector<string> lastrule;
-	int lno = 0, pos = 0;
+	vector<string> lastrule, rulebuf;
+	int lno = 0, pos = 0, tbase = 0, tend = 0;
+	int quiet = 0;  // no load messages (parallel loading)
 
 	// state info
 	int eof()               const { return lno >= lines.size(); }
-	int eol(int off=0)      const { return pos + off >= tokens.size(); }
+	int eol(int off=0)      const { return tbase + pos + off >= tend; }
 	int lineno()            const { return lno + 1; }
-	string peekline()       const { return lno < lines.size() ? lines[lno] : "<EOF>"; }
-	string tokenat(int off) const { return eof() ? "<EOF>" : eol(off) ? "<EOL>" : tokens[pos + off]; }
+	string peekline()       const { return lno < lines.size() ? string(lines[lno]) : "<EOF>"; }
+	string tokenat(int off) const { return eof() ? "<EOF>" : eol(off) ? "<EOL>" : string(toks[tbase + pos + off].text); }
 	string currenttoken()   const { return tokenat(0); }
 
 	// mutators
@@ -38,78 +93,97 @@ struct InputFile {
 
 	// loading
 	int load(const string& fname) {
-		// reset
-		lines = tokens = {};
-		lno = pos = 0;
-		// load
-		fstream fs(fname, ios::in);
-		if (!fs.is_open())
+		if (srcmap.open(fname))
 			return fprintf(stderr, "error loading file %s\n", fname.c_str()), 1;
 		this->fname = fname;
-		string s;
-		while (getline(fs, s))
-			lines.push_back(s);
-		printf("loaded file: %s (%d)\n", fname.c_str(), (int)lines.size());
+		lex( srcmap.view() );
+		if (!quiet)  printf("loaded file: %s (%d)\n", fname.c_str(), (int)lines.size());
 		tokenizeline();
 		return 0;
 	}
 	int loadstring(const string& program) {
-		// reset
-		lines = tokens = {};
-		lno = pos = 0;
-		// load
-		stringstream ss(program);
-		string s;
-		while (getline(ss, s))
-			lines.push_back(s);
+		srcmap.close();
+		srcbuf = program;
+		lex( srcbuf );
 		printf("loaded program string.\n");
 		tokenizeline();
 		return 0;
 	}
 
-	// main parsing function
-	int tokenizeline() {
-		// reset & check
-		tokens = {};
-		pos = 0;
-		if (lno < 0 || lno >= lines.size())  return 0;
-		// split
-		auto& line = lines[lno];
-		string s;
-		for (int i = 0; i < line.length(); i++) {
+	// tokenize the whole source in one pass. lexing errors are held until the parser reaches their line
+	void lex(string_view src) {
+		lines.clear(),  toks.clear(),  linetok.clear(),  escaped.clear();
+		lexerr_line = -1,  lexerr_msg = "";
+		lno = pos = tbase = tend = 0;
+		toks.reserve(src.size() / 4);  // rough guess, saves regrowing the arrays on large files
+		lines.reserve(src.size() / 32),  linetok.reserve(src.size() / 32);
+		for (size_t i = 0; i < src.size(); ) {
+			size_t j = src.find('\n', i);
+			if (j == string_view::npos)  j = src.size();
+			lines.push_back(src.substr(i, j - i));
+			linetok.push_back(toks.size());
+			lexline(lines.back());
+			i = j + 1;
+		}
+		linetok.push_back(toks.size());
+	}
+	void lexline(string_view line) {
+		auto lexerr = [&](const string& msg) { if (lexerr_line == -1)  lexerr_line = lines.size() - 1,  lexerr_msg = msg; };
+		static const auto IDCHAR = [] { array<uint8_t, 256> t = {};  for (int c = 0; c < 256; c++)  t[c] = isalnum(c) || c == '_';  return t; }();
+		size_t n = line.size();
+		for (size_t i = 0; i < n; ) {
 			char c = line[i];
-			if (isalnum(c) || c == '_')  s += c;  // id / number
-			else {
-				if (s.length())  tokens.push_back(s), s = "";  // next token
-				if      (isspace(c)) { }  // whitespace (ignore)
-				else if (c == '#')   { tokens.push_back(line.substr(i));  break; }  // line comment
-				else if (c == '"')   {    // string literal
-					s += c;
-					for (i++; i < line.length(); i++) {
-						c = line[i];
-						if (c == '\\') {  // escape character
-							if    (i < line.length()-1 && line[i+1] == '"')  s += c,  i++;
-							else  throw error("bad string escape sequence");
-						}
-						else {            // normal character
-							s += c;
-							if (c == '"')  break;
-						}
+			if (IDCHAR[(uint8_t)c]) {  // id / number
+				size_t j = i;
+				while (j < n && IDCHAR[(uint8_t)line[j]])  j++;
+				auto t = line.substr(i, j - i);
+				toks.push_back({ t, uint8_t( isalpha(c) || c == '_' ? TK_IDENTIFIER
+					: t.find_first_not_of("0123456789") == string_view::npos ? TK_INTEGER : TK_OTHER ) });
+				i = j;
+			}
+			else if (isspace(c))  i++;  // whitespace (ignore)
+			else if (c == '#')  { toks.push_back({ line.substr(i), TK_COMMENT });  break; }  // line comment
+			else if (c == '"') {  // string literal
+				size_t j = i + 1;
+				int    esc = 0;
+				for ( ; j < n; j++)
+					if (line[j] == '\\') {  // escape character
+						if    (j < n-1 && line[j+1] == '"')  esc = 1,  j++;
+						else  return lexerr("bad string escape sequence");
 					}
-					if (s.length() < 2 || s.back() != '"')
-						throw error("unterminated string");
-					tokens.push_back(s),  s = "";
+					else if (line[j] == '"')  break;
+				if (j >= n)  return lexerr("unterminated string");
+				if (esc) {  // escaped quotes keep the backslash and drop the quote
+					string s;
+					for (size_t k = i; k <= j; k++)
+						if    (line[k] == '\\')  s += line[k++];
+						else  s += line[k];
+					escaped.push_back(s);
+					toks.push_back({ escaped.back(), TK_LITERAL });
 				}
-				else                 { tokens.push_back(string() + c); }  // punctuation
+				else
+					toks.push_back({ line.substr(i, j - i + 1), TK_LITERAL });
+				i = j + 1;
+			}
+			else {  // punctuation
+				toks.push_back({ line.substr(i, 1), uint8_t(c == '+' || c == '-' ? TK_SIGN : TK_OTHER) });
+				i++;
 			}
 		}
-		if (s.length())  tokens.push_back(s);
+	}
+
+	// move to the current line's tokens
+	int tokenizeline() {
+		pos = 0;
+		if (lno < 0 || lno >= lines.size())  return tbase = tend = 0,  0;
+		tbase = linetok[lno],  tend = linetok[lno + 1];
+		if (lno == lexerr_line)  throw error(lexerr_msg);
 		return 1;
 	}
 
 	// token access :: (simplified version of dbas6)
 	int peekt(const string& tok, int off=0) {
-		if (!eof() && !eol(off) && tokens[pos + off] == tok)
+		if (!eof() && !eol(off) && toks[tbase + pos + off].text == tok)
 			return lasttok = tok, 1;
 		return 0;
 	}
@@ -120,19 +194,33 @@ struct InputFile {
 		if (!expectt(tok))  throw error("expected token", tok);
 		return 1;
 	}
-	int peekp(const string& pat, int off=0) {
-		string tok = tokenat(off);
-		int res = 0;
-		// printf("rulecheck  %s \n", tok.c_str() );
-		if      (pat == "eof")         res = eof();
-		else if (pat == "eol")         res = eol(off);
-		else if (pat == "endl")        res = eof() || eol(off) || Tokens::is_comment(tok);
-		else if (pat == "integer")     res = Tokens::is_integer(tok);
-		else if (pat == "sign")        res = tok == "+" || tok == "-";
-		else if (pat == "identifier")  res = Tokens::is_identifier(tok);
-		else if (pat == "literal")     res = Tokens::is_literal(tok);
+	static Pat getpattern(const string& pat) {
+		if      (pat == "eof")         return PAT_EOF;
+		else if (pat == "eol")         return PAT_EOL;
+		else if (pat == "endl")        return PAT_ENDL;
+		else if (pat == "integer")     return PAT_INTEGER;
+		else if (pat == "sign")        return PAT_SIGN;
+		else if (pat == "identifier")  return PAT_IDENTIFIER;
+		else if (pat == "literal")     return PAT_LITERAL;
 		else  throw runtime_error("unknown pattern: " + pat);
-		return lasttok = tok, res;
+	}
+	int peekpat(Pat pat, int off=0) {
+		int k = eof() || eol(off) ? -1 : toks[tbase + pos + off].kind,  res = 0;
+		switch (pat) {
+		case PAT_EOF:         res = eof();  break;
+		case PAT_EOL:         res = eol(off);  break;
+		case PAT_ENDL:        res = k == -1 || k == TK_COMMENT;  break;
+		case PAT_INTEGER:     res = k == TK_INTEGER;  break;
+		case PAT_SIGN:        res = k == TK_SIGN;  break;
+		case PAT_IDENTIFIER:  res = k == TK_IDENTIFIER;  break;
+		case PAT_LITERAL:     res = k == TK_LITERAL;  break;
+		default:              break;
+		}
+		if (res)  lasttok = tokenat(off);
+		return res;
+	}
+	int peekp(const string& pat, int off=0) {
+		return peekpat(getpattern(pat), off);
 	}
 	int expectp(const string& pat) {
 		return peekp(pat) ? ++pos, 1 : 0;
@@ -143,23 +231,46 @@ struct InputFile {
 	}
 
 	// full ruleset matching :: (much reduced from dbas 4 -> 6)
-	int peek(const string& ruleset) {
-		int off = 0;
-		vector<string> vs;
+	static Rule compilerule(const string& ruleset) {
+		Rule r;
 		for (const auto& rule : Strings::split(ruleset))
-			if      (rule.at(0) == '@' && peekp(rule.substr(1), off))  off++, vs.push_back(lasttok);  // token rule match
+			if      (rule.at(0) == '@')  r.push_back({ getpattern(rule.substr(1)), "", 1 });  // token rule match
 			// TODO: is this a good symbol choice (backtick)?
-			else if (rule.at(0) == '`' && peekt(rule.substr(1), off))  off++, vs.push_back(lasttok);  // basic match (save)
-			else if (rule.at(0) != '@' && peekt(rule, off))  off++;                                   // basic match (don't save - default)
-			else    return 0;
-		lastrule = vs;
+			else if (rule.at(0) == '`')  r.push_back({ PAT_TOKEN, rule.substr(1), 1 });      // basic match (save)
+			else                         r.push_back({ PAT_TOKEN, rule, 0 });                // basic match (don't save - default)
+		return r;
+	}
+	// rules are compiled once per text (per parse thread). lookups go by address first, as callers
+	// pass literals, but a hit only counts if the text still matches, so any ruleset is safe
+	struct RuleEntry { string text; Rule rule; };
+	static const Rule& getrule(const char* ruleset) {
+		thread_local unordered_map<const char*, const RuleEntry*>  byaddr;
+		thread_local unordered_map<string_view, const RuleEntry*>  bytext;  // keys view into entries
+		thread_local deque<RuleEntry>                              entries;
+		auto it = byaddr.find(ruleset);
+		if (it != byaddr.end() && it->second->text == ruleset)  return it->second->rule;
+		auto jt = bytext.find(ruleset);
+		if (jt == bytext.end())
+			entries.push_back({ ruleset, compilerule(ruleset) }),
+			jt = bytext.emplace(entries.back().text, &entries.back()).first;
+		byaddr[ruleset] = jt->second;
+		return jt->second->rule;
+	}
+	int peek(const char* ruleset) {
+		int off = 0;
+		rulebuf.clear();
+		for (const auto& r : getrule(ruleset))
+			if      (r.pat == PAT_TOKEN ? !peekt(r.tok, off) : !peekpat(r.pat, off))  return 0;
+			else if (r.save)  rulebuf.push_back(lasttok),  off++;
+			else    off++;
+		lastrule = rulebuf;
 		return off;
 	}
-	int expect(const string& ruleset) {
+	int expect(const char* ruleset) {
 		int matchc = peek(ruleset);
 		return matchc ? pos += matchc, matchc : 0;
 	}
-	int require(const string& ruleset) {
+	int require(const char* ruleset) {
 		if (!expect(ruleset))  throw error("syntax error near", currenttoken());
 		return 1;
 	}
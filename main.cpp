@@ -2,29 +2,134 @@
 #include "debug.hpp"
 #include "parser.hpp"
 #include "runtime.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "image.hpp"
+#include "project.hpp"
+#include <chrono>
+#include <filesystem>
 using namespace std;
 
 
-void runscript(const string& fname) {
-	// parse
-	Parser p;
-	p.load("scripts/" + fname + ".bas");
-	printf("-----\n");
-	p.parse();
-	Progshow(p.prog).tofile("bin/prog.tree");
+// a script name is scripts/<name>.bas, or a scripts/<name>/ directory of .bas files (a project)
+vector<string> scriptfiles(const vector<string>& names) {
+	vector<string> files;
+	for (auto& name : names) {
+		string dir = "scripts/" + name;
+		if (!filesystem::is_directory(dir)) {
+			files.push_back(dir + ".bas");
+			continue;
+		}
+		vector<string> dfiles;
+		for (auto& e : filesystem::directory_iterator(dir))
+			if (e.path().extension() == ".bas")  dfiles.push_back(e.path().string());
+		sort(dfiles.begin(), dfiles.end());  // link order must not depend on the file system
+		files.insert(files.end(), dfiles.begin(), dfiles.end());
+	}
+	return files;
+}
+
+
+// source files and modification times, for --watch
+typedef  vector<pair<string, filesystem::file_time_type>>  Stamps;
+Stamps stamps(const vector<string>& names) {
+	Stamps st;
+	error_code ec;
+	for (auto& f : scriptfiles(names))
+		st.push_back({ f, filesystem::last_write_time(f, ec) });
+	return st;
+}
+int waitchange(const vector<string>& names, Stamps& last) {
+	fflush(stdout);
+	for (Stamps now; ; this_thread::sleep_for(chrono::milliseconds(200)))
+		if ((now = stamps(names)) != last)  return last = now,  1;
+}
+
+
+void runscript(Project& p, const vector<string>& names, int treemode, int superinstr, int useimage, int profile, int trace, int census) {
+	vector<string> src   = scriptfiles(names);
+	string         img   = "bin/" + names.at(0) + ".dbc";
+	uint32_t       flags = superinstr | profile << 1 | trace << 2 | census << 3;
+	VM r;
+	r.profile = profile,  r.trace = trace,  r.census = census;
+	// load precompiled image, if it matches the source (VM only: the tree-walker needs the full Prog)
+	auto l0 = chrono::steady_clock::now();
+	uint64_t srchash = useimage && !treemode ? Image::hashfiles(src) : 0;
+	if (useimage && !treemode && Image::load(img, r.prog, r.bc, srchash, flags)) {
+		auto l1 = chrono::steady_clock::now();
+		printf("-----\n");
+		printf("  startup: %.3f ms (image)\n", chrono::duration<double, milli>(l1 - l0).count() );
+	}
+	else {
+		// parse and link
+		p.files = src;
+		printf("loading project: %s (%d files)\n", names.at(0).c_str(), (int)src.size());
+		printf("-----\n");
+		p.build();
+		auto p1 = chrono::steady_clock::now();
+		double pms = chrono::duration<double, milli>(p1 - l0).count();
+		printf("  parse time: %.3f ms (%.0f lines/s | parsed %d of %d units)\n", pms, p.lines / (pms / 1000), p.parsed, p.units );
+		Progshow(p.prog).tofile("bin/prog.tree");
+		// compile
+		r.prog = move(p.prog);
+		if (!treemode)
+			r.compile(superinstr),
+			r.bc.tofile("bin/prog.bc");
+		auto c1 = chrono::steady_clock::now();
+		printf("  startup: %.3f ms (parse)\n", chrono::duration<double, milli>(c1 - l0).count() );
+		if (useimage && !treemode)
+			Image::write(img, r.prog, r.bc, srchash, flags);
+	}
 	printf("-----\n");
-	// run
-	Runtime r;
-	r.prog = p.prog;
-	r.run();
+	// run (tree-walking Runtime is kept as the reference mode)
+	if (trace && r.tracer.start(r.prog, "bin/trace.json"))  r.trace = 0;
+	auto t0 = chrono::steady_clock::now();
+	treemode ? r.Runtime::run() : r.run();
+	auto t1 = chrono::steady_clock::now();
+	if (r.trace)
+		r.tracer.stop(),
+		printf("wrote trace to: bin/trace.json (%d events, %d calls untraced)\n", (int)r.tracer.events, (int)r.tracer.dropped);
 	printf("-----\n");
 	r.show();
+	printf("  run time: %.3f ms (%s)\n", chrono::duration<double, milli>(t1 - t0).count(),
+		treemode ? "tree" : superinstr ? VM::DISPATCH : (VM::DISPATCH + string(", no superinstructions")).c_str() );
+	// --census: heap use by type, function and call site
+	if (census)
+		r.cen.show(r.prog);
+	// --profile: hot lines and functions, and the annotated source
+	if (profile)
+		r.prof.show(r.prog),
+		r.prof.tofile(r.prog, "bin/profile.txt");
 }
 
 
-int main() {
+int main(int argc, char** argv) {
 	printf("hello world\n");
 
+	vector<string> scripts;
+	int treemode = 0, superinstr = 1, useimage = 1, watch = 0, profile = 0, trace = 0, census = 0;
+	Project proj;
+	for (int i = 1; i < argc; i++)
+		if      (string(argv[i]) == "--tree")     treemode = 1;
+		else if (string(argv[i]) == "--nosuper")  superinstr = 0;
+		else if (string(argv[i]) == "--noimage")  useimage = 0;
+		else if (string(argv[i]) == "--profile")  profile = 1;
+		else if (string(argv[i]) == "--trace")    trace = 1;
+		else if (string(argv[i]) == "--census")   census = 1;
+		else if (string(argv[i]) == "--watch")    watch = proj.incremental = 1;
+		else if (string(argv[i]) == "--threads" && i + 1 < argc)  proj.threads = stoi(argv[++i]);
+		else    scripts.push_back(argv[i]);
+	if (scripts.empty())  scripts.push_back("advent2");
+
 	// runscript("scratch");
-	runscript("advent2");
-}
\ No newline at end of file
+	// --watch: build and run again each time a source file changes. only changed functions are re-parsed
+	Stamps last = stamps(scripts);
+	do  try {
+		runscript(proj, scripts, treemode, superinstr, useimage, profile, trace, census);
+	}
+	catch (exception& e) {
+		if (!watch)  throw;
+		fprintf(stderr, "error: %s\n", e.what());
+	}
+	while (watch && waitchange(scripts, last));
+}
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
 #include "dbas7.hpp"
 #include "inputfile.hpp"
 using namespace std;
@@ -15,59 +17,103 @@ struct Parser : InputFile {
 	Prog prog;
 	// parser state
 	int flag_mod = 0, flag_func = -1, flag_loop = 0;
+	// symbol tables, kept in step with prog. name -> index into the matching prog list
+	typedef  unordered_map<string, int32_t>  Scope;
+	Scope          sym_types, sym_globals, sym_funcs;
+	vector<Scope>  sym_members;  // per type: member name -> member index
+	Scope          sym_locals;   // current function: argument / local name -> frame slot
+	unordered_map<string, string>         sym_rets;          // function link name -> return type, from p_prescan
+	const unordered_map<string, string>*  proj_rets = NULL;  // the same for every file of a project, set by Project
 
 
 
 // --- State checking ---
 
+	static int symfind(const Scope& scope, const string& name) {
+		auto it = scope.find(name);
+		return it == scope.end() ? -1 : it->second;
+	}
 	int is_type(const string& type) const {
 		if (type == "int" || type == "string")  return 1;
-		for (auto& t : prog.types)
-			if (t.name == type)  return 1;
-		return 0;
+		return symfind(sym_types, type) > -1;
 	}
 	int is_global(const string& name) const {
-		for (auto& g : prog.globals)
-			if (g.name == name)  return 1;
-		return 0;
+		return symfind(sym_globals, name) > -1;
 	}
 	int is_local(const string& name) const {
 		if (flag_func <= -1)  return 0;
-		auto& fn = prog.functions.at(flag_func);
-		for (auto& a : fn.args)
-			if (a.name == name)  return 1;
-		for (auto& l : fn.locals)
-			if (l.name == name)  return 1;
-		return 0;
+		return symfind(sym_locals, name) > -1;
 	}
 	int is_member(const string& type, const string& member) const {
-		for (auto& t : prog.types)
-			for (auto& m : t.members)
-				if (t.name == type && m.name == member)  return 1;
-		return 0;
+		int t = symfind(sym_types, type);
+		return t > -1 && symfind(sym_members.at(t), member) > -1;
 	}
-	int is_func(const string& fname) {
-		static vector<string> fn_system = { "push", "pop", "len", "default" };
+	int is_func(const string& fname) const {
+		return is_sysfunc(fname) || symfind(sym_funcs, fname) > -1;
+	}
+	static int is_sysfunc(const string& fname) {
+		static const vector<string> fn_system = { "push", "pop", "len", "default" };
 		for (auto& n : fn_system)
 			if (fname == n)  return 1;
-		for (auto& fn : prog.functions)
-			if (fn.name == fname)  return 1;
 		return 0;
 	}
+	// the name a function, or a call from the given module, is linked by: module:f, or plain f in the default module
+	static string linkname(const string& module, const string& fname) {
+		auto c = fname.find(':');
+		if (c != string::npos)  return fname.compare(0, c, "default") == 0 ? fname.substr(c + 1) : fname;
+		return module == "default" || is_sysfunc(fname) ? fname : module + ":" + fname;
+	}
+	string getrettype(const string& fname) const {
+		const auto& rets = proj_rets ? *proj_rets : sym_rets;
+		auto it = rets.find(linkname(prog.module, fname));
+		return it == rets.end() ? "int" : it->second;  // unknown functions are reported by p_callcheck
+	}
 
 
 
 // --- Main parsing functions ---
 
 	void parse() {
+		parse_file();
+		p_callcheck_all();
+		p_link();
+	}
+
+	// parse one file on its own. calls are checked and resolved afterwards, by parse() or by the Project linker
+	void parse_file() {
+		p_prescan();
+		p_header();
+		p_section("function");
+		if (!eof())  throw error("unexpected command", currenttoken());
+	}
+
+	// everything before the first function: module name, types and globals
+	void p_header() {
 		prog.module = "default";
 		prog.files.push_back(fname);
 		p_section("module");
 		p_section("type");
 		p_section("dim");
-		p_section("function");
-		if (!eof())  throw error("unexpected command", currenttoken());
-		p_callcheck_all();
+	}
+
+	// read the module name and each function's return type ahead of parsing, so that calls
+	// are typed before (or without) the parse of the function they call
+	void p_prescan() {
+		string module = "default";
+		vector<pair<string, string>> fns;  // name, type
+		for (lno = 0; lno < (int)lines.size(); lno++) {
+			if (lno == lexerr_line || linetok[lno] == linetok[lno+1])  continue;  // lexing errors wait for the parse
+			auto first = toks[ linetok[lno] ].text;
+			if (first != "module" && first != "function")  continue;
+			tokenizeline();
+			if      (expect("module @identifier"))                      module = lastrule.at(0);
+			else if (expect("function @identifier [ ] @identifier ("))  fns.push_back({ lastrule.at(1), lastrule.at(0) + "[]" });
+			else if (expect("function @identifier @identifier ("))      fns.push_back({ lastrule.at(1), lastrule.at(0) });
+			else if (expect("function @identifier ("))                  fns.push_back({ lastrule.at(0), "int" });
+		}
+		for (auto& f : fns)
+			sym_rets.emplace(linkname(module, f.first), f.second);
+		lno = 0,  tokenizeline();
 	}
 
 	Prog::Dsym dsym() {
@@ -96,7 +142,9 @@ struct Parser : InputFile {
 		string ctype = lastrule.at(0);
 		if (Tokens::is_keyword(ctype) || is_type(ctype) || is_global(ctype))
 			throw error("type name collision", ctype);
+		sym_types.emplace(ctype, prog.types.size());
 		prog.types.push_back({ ctype });
+		sym_members.push_back({});
 		// type members
 		while (!eof()) {	
 			if      (expect("@endl"))  { nextline();  continue; }
@@ -104,6 +152,7 @@ struct Parser : InputFile {
 			Prog::Dim d = p_dim_start();
 			if (is_member(ctype, d.name))
 				throw error("type member collision", d.type + ":" + d.name);
+			sym_members.back().emplace(d.name, prog.types.back().members.size());
 			prog.types.back().members.push_back(d);  // save type member
 			require("@endl"), nextline();  // next member
 		}
@@ -136,6 +185,7 @@ struct Parser : InputFile {
 				throw error("global redefined", dim.name);
 			if (expect("="))
 				dim.expr = p_expr(dim.type);
+			sym_globals.emplace(dim.name, prog.globals.size());
 			prog.globals.push_back(dim);
 			if (!expect(","))  // comma seperated defines
 				break;
@@ -152,7 +202,9 @@ struct Parser : InputFile {
 				throw error("local redefined", dim.name);
 			if (expect("="))
 				dim.expr = p_expr(dim.type);
-			prog.functions.at(flag_func).locals.push_back(dim);
+			auto& fn = prog.functions.at(flag_func);
+			sym_locals.emplace(dim.name, fn.args.size() + fn.locals.size());
+			fn.locals.push_back(dim);
 			if (!expect(","))  // comma seperated defines
 				break;
 			require("@identifier");
@@ -162,18 +214,26 @@ struct Parser : InputFile {
 	}
 
 	void p_function() {
-		// function header start
-		require("function @identifier (");
-		auto fname = lastrule.at(0);
+		// function header start. the return type is optional (int)
+		string type = "int",  fname;
+		if      (expect ("function @identifier [ ] @identifier ("))  type = lastrule.at(0) + "[]",  fname = lastrule.at(1);
+		else if (expect ("function @identifier @identifier ("))      type = lastrule.at(0),         fname = lastrule.at(1);
+		else if (require("function @identifier ("))                  fname = lastrule.at(0);
+		if (!is_type(Tokens::basetype(type)))
+			throw error("unknown return type", type);
 		if (Tokens::is_keyword(fname) || is_global(fname) || is_func(fname))
 			throw error("function name collision", fname);
+		sym_funcs.emplace(fname, prog.functions.size());
 		prog.functions.push_back({ fname });
+		prog.functions.back().type = type;
 		flag_func = prog.functions.size() - 1;
 		auto& fn  = prog.functions.back();
 		fn.dsym   = dsym();
+		sym_locals.clear();  // new function scope
 		// function arguments
 		while (!eol() && !peek(")")) {
 			fn.args.push_back( p_dim_argument() );
+			sym_locals.emplace(fn.args.back().name, fn.args.size() - 1);
 			if (!expect(","))  break;  // comma seperated arguments
 		}
 		// function header end
@@ -188,6 +248,7 @@ struct Parser : InputFile {
 		// end
 		require("end function @endl"), nextline();
 		flag_func = -1;
+		sym_locals.clear();
 	}
 
 
@@ -198,27 +259,30 @@ struct Parser : InputFile {
 		prog.blocks.push_back({ });
 		int   blp = prog.blocks.size() - 1;
 		auto& stm = prog.blocks.back().statements;
-		while (!eof())
+		while (!eof()) {
+			auto ds = dsym();  // where the statement starts
 			if      (expect("@endl"))         nextline();
 			else if (peek("end"))             break;  // end all control blocks
 			else if (peek("else"))            break;  // end if-sub-block
 			// I/O
-			else if (peek("print"))           stm.push_back({ "print",      p_print() });
-			else if (peek("input"))           stm.push_back({ "input",      p_input() });
+			else if (peek("print"))           stm.push_back({ Stmt::print,     p_print(), ds });
+			else if (peek("input"))           stm.push_back({ Stmt::input,     p_input(), ds });
 			// control blocks
-			else if (peek("if"))              stm.push_back({ "if",         p_if() });
-			else if (peek("while"))           stm.push_back({ "while",      p_while() });
-			else if (peek("for"))             stm.push_back({ "for",        p_for() });
+			else if (peek("if"))              stm.push_back({ Stmt::if_,       p_if(), ds });
+			else if (peek("while"))           stm.push_back({ Stmt::while_,    p_while(), ds });
+			else if (peek("for"))             stm.push_back({ Stmt::for_,      p_for(), ds });
 			// control
-			else if (peek("return"))          stm.push_back({ "return",     p_return() });
-			else if (peek("break"))           stm.push_back({ "break",      p_break() });
-			else if (peek("continue"))        stm.push_back({ "continue",   p_continue() });
+			else if (peek("return"))          stm.push_back({ Stmt::return_,   p_return(), ds });
+			else if (peek("break"))           stm.push_back({ Stmt::break_,    p_break(), ds });
+			else if (peek("continue"))        stm.push_back({ Stmt::continue_, p_continue(), ds });
 			// expressions
-			else if (peek("let"))             stm.push_back({ "let",        p_let() });
-			else if (peek("call"))            stm.push_back({ "call",       p_call_stmt() });
-			else if (peek("@identifier ("))   stm.push_back({ "call",       p_call_stmt() });
-			else if (peek("@identifier"))     stm.push_back({ "let",        p_let() });
+			else if (peek("let"))             stm.push_back({ Stmt::let,       p_let(), ds });
+			else if (peek("call"))            stm.push_back({ Stmt::call,      p_call_stmt(), ds });
+			else if (peek("@identifier ("))   stm.push_back({ Stmt::call,      p_call_stmt(), ds });
+			else if (peek("@identifier :"))   stm.push_back({ Stmt::call,      p_call_stmt(), ds });  // module:function()
+			else if (peek("@identifier"))     stm.push_back({ Stmt::let,       p_let(), ds });
 			else    throw error("unexpected block statement", currenttoken());
+		}
 		return blp;
 	}
 
@@ -234,12 +298,12 @@ struct Parser : InputFile {
 		while (!eol()) {
 			int   exp = p_expr_any();
 			auto& ex  = prog.exprs.at(exp);
-			if      (ex.type == "int")     pr.instr.push_back({ "expr",     exp });
-			else if (ex.type == "string")  pr.instr.push_back({ "expr_str", exp });
+			if      (ex.type == "int")     pr.instr.push_back({ Cmd::expr,     exp });
+			else if (ex.type == "string")  pr.instr.push_back({ Cmd::expr_str, exp });
 			else    throw error("unexpected type in print", ex.type);
 			// whitespace seperators
-			if      (expect(","))  pr.instr.push_back({ "literal", p_addliteral(" ")  });
-			// else if (expect(";"))  pr.instr.push_back({ "literal", p_addliteral("\t") });
+			if      (expect(","))  pr.instr.push_back({ Cmd::literal, p_addliteral(" ")  });
+			// else if (expect(";"))  pr.instr.push_back({ Cmd::literal, p_addliteral("\t") });
 		}
 		require("@endl"), nextline();
 		return prp;
@@ -327,8 +391,10 @@ struct Parser : InputFile {
 
 	int p_return() {
 		require("return");
+		const auto& type = prog.functions.at(flag_func).type;
 		int ex = -1;  // default: no expression
-		if (!peek("@endl"))  ex = p_expr("int");
+		if      (!peek("@endl"))  ex = p_expr(type);
+		else if (type != "int")   throw error("expected return value", type);
 		require("@endl"), nextline();
 		return ex;
 	}
@@ -357,10 +423,51 @@ struct Parser : InputFile {
 		let.type    = prog.varpaths.at(let.varpath).type;       // get varpath type
 		require("=");
 		let.expr    = p_expr(let.type);                         // parse src varpath as type
+		if (let.type == "string")  p_let_append(let);           // s = s + ... appends in place
 		require("@endl"), nextline();
 		return letp;
 	}
 
+	void p_let_append(Prog::Let& let) {
+		auto&       ex   = prog.exprs.at(let.expr).instr;
+		const auto& dest = prog.varpaths.at(let.varpath).instr;
+		if (ex.size() < 3 || ex[0].cmd != Cmd::varpath_str || ex.back().cmd != Cmd::strcat)  return;
+		// source must be the same path as the destination, with no index expressions
+		const auto& src = prog.varpaths.at(ex[0].iarg).instr;
+		if (src.size() != dest.size())  return;
+		for (size_t i = 0; i < dest.size(); i++)
+			if      (dest[i].cmd != Cmd::get && dest[i].cmd != Cmd::get_global && dest[i].cmd != Cmd::memget_prop)  return;
+			else if (src[i].cmd != dest[i].cmd || src[i].iarg != dest[i].iarg)  return;
+		// drop the source read, and the strcat that joins the tail onto it (first one at depth 2)
+		vector<Prog::Instruction> tail;
+		int depth = 1, dropped = 0;
+		for (size_t i = 1; i < ex.size(); i++) {
+			auto& in = ex[i];
+			if (has_call(in))  return;  // could change the destination mid-expression
+			if (in.cmd == Cmd::strcat && depth == 2 && !dropped) {
+				dropped = 1, depth--;
+				continue;
+			}
+			switch (in.cmd) {
+			case Cmd::i:  case Cmd::lit:  case Cmd::varpath:  case Cmd::varpath_str:  case Cmd::varpath_ptr:  depth++;  break;
+			default:  depth--;  break;  // binary operators
+			}
+			tail.push_back(in);
+		}
+		ex = tail;
+		let.append = 1;
+	}
+	// instruction is a call, or reads a varpath with a call in one of its index expressions
+	int has_call(const Prog::Instruction& in) {
+		if (in.cmd == Cmd::call)  return 1;
+		if (in.cmd != Cmd::varpath && in.cmd != Cmd::varpath_str && in.cmd != Cmd::varpath_ptr)  return 0;
+		for (auto& vin : prog.varpaths.at(in.iarg).instr)
+			if (vin.cmd == Cmd::memget_expr || vin.cmd == Cmd::memget_chr)
+				for (auto& ein : prog.exprs.at(vin.iarg).instr)
+					if (has_call(ein))  return 1;
+		return 0;
+	}
+
 
 
 // --- Variable path handling ---
@@ -382,22 +489,21 @@ struct Parser : InputFile {
 		string  type,  prop,  varname = lastrule.at(0);
 		if (is_local(varname))
 			type = getlocaltype(varname),
-			inst.push_back({ "get", 0, varname });
+			inst.push_back({ Cmd::get, getlocalslot(varname), varname });
 		else
 			type = getglobaltype(varname),
-			inst.push_back({ "get_global", 0, varname });
+			inst.push_back({ Cmd::get_global, getglobalslot(varname), varname });
 		// path chain
 		while (!eol())
 			if (expect("[")) {
-				inst.push_back({ "memget_expr", p_expr("int") });
-				require("]");
-				if      (Tokens::is_arraytype(type))  type = Tokens::basetype(type);
-				else if (type == "string")            type = "int";
+				if      (Tokens::is_arraytype(type))  inst.push_back({ Cmd::memget_expr, p_expr("int") }),  type = Tokens::basetype(type);
+				else if (type == "string")            inst.push_back({ Cmd::memget_chr,  p_expr("int") }),  type = "int";  // string character
 				else                                  throw error("expected array / string in array-subscript", type);
+				require("]");
 			}
 			else if (expect(".")) {
 				require("@identifier"),  prop = lastrule.at(0);
-				inst.push_back({ "memget_prop", 0, "USRTYPE_" + type + "_" + prop });
+				inst.push_back({ Cmd::memget_prop, getpropindex(type, prop), type + "." + prop });
 				type = getproptype(type, prop);
 			}
 			else
@@ -408,24 +514,32 @@ struct Parser : InputFile {
 
 	// p_varpath helpers
 	string getglobaltype(const string& name) const {
-		for (auto& g : prog.globals)
-			if (g.name == name)  return g.type;
-		throw error("undefined global", name);
+		return prog.globals[ getglobalslot(name) ].type;
 	}
 	string getlocaltype(const string& name) const {
-		auto& fn = prog.functions.at(flag_func);
-		for (auto& d : fn.args)
-			if (d.name == name)  return d.type;
-		for (auto& d : fn.locals)
-			if (d.name == name)  return d.type;
-		throw error("undefined argument or local", name);
+		auto&   fn   = prog.functions.at(flag_func);
+		int32_t slot = getlocalslot(name);
+		return slot < (int32_t)fn.args.size() ? fn.args[slot].type : fn.locals[slot - fn.args.size()].type;
+	}
+	// frame slots: arguments first, then locals, in declaration order
+	int32_t getlocalslot(const string& name) const {
+		int32_t slot = symfind(sym_locals, name);
+		if (slot == -1)  throw error("undefined argument or local", name);
+		return slot;
+	}
+	int32_t getglobalslot(const string& name) const {
+		int32_t slot = symfind(sym_globals, name);
+		if (slot == -1)  throw error("undefined global", name);
+		return slot;
+	}
+	int32_t getpropindex(const string& type, const string& prop) const {
+		int32_t t = symfind(sym_types, type);
+		int32_t i = t == -1 ? -1 : symfind(sym_members.at(t), prop);
+		if (i == -1)  throw error("type or property not defined", type + "." + prop);
+		return i;
 	}
 	string getproptype(const string& type, const string& prop) const {
-		for (auto& t : prog.types)
-			if (t.name == type)
-				for (auto& m : t.members)
-					if (m.name == prop)  return m.type;
-		throw error("type or property not defined", type + "." + prop);
+		return prog.types[ symfind(sym_types, type) ].members[ getpropindex(type, prop) ].type;
 	}
 
 
@@ -440,12 +554,14 @@ struct Parser : InputFile {
 	}
 
 	int p_call() {
-		require("@identifier (");
-		string fname = lastrule.at(0);
+		string fname;
+		if    (expect("@identifier : @identifier ("))  fname = lastrule.at(0) + ":" + lastrule.at(1);  // resolved by the Project linker
+		else  require("@identifier ("),  fname = lastrule.at(0);
 		prog.calls.push_back({ fname });
 		int   cap = prog.calls.size() - 1;
 		auto& ca  = prog.calls.back();
 		ca.dsym   = dsym();
+		ca.type   = getrettype(fname);
 		// arguments
 		while (!eol() && !peek(")")) {
 			int ex = p_expr_any();
@@ -485,13 +601,27 @@ struct Parser : InputFile {
 					+ " expected " + fn.args[i].type + "(" + to_string(i+1) + ")"
 					+ ", got " + ca.args[i].type,
 					ca.dsym);
+		// calls were typed from the headers, ahead of the function itself
+		if (ca.type != fn.type)
+			throw errordsym("incorrect return type. expected " + fn.type + ", got " + ca.type, ca.dsym);
 		// OK 
 		return 1;
 	}
+	// resolve every call to a function index or system function id, so calls never look up names at runtime
+	void p_link() {
+		static const map<string, Sys> fn_system = {
+			{ "push", Sys::push }, { "pop", Sys::pop }, { "len", Sys::len }, { "default", Sys::default_ } };
+		for (auto& ca : prog.calls) {
+			auto it = sym_funcs.find(ca.fname);
+			auto st = fn_system.find(ca.fname);
+			if      (it != sym_funcs.end())  ca.func = it->second,  ca.sys = Sys::none;
+			else if (st != fn_system.end())  ca.func = -1,          ca.sys = st->second;
+			else    throw errordsym("function undefined: " + ca.fname, ca.dsym);
+		}
+	}
+
 	int getfuncindex(const string& fname) const {
-		for (int i = 0; i < prog.functions.size(); i++)
-			if (prog.functions[i].name == fname)  return i;
-		return -1;
+		return symfind(sym_funcs, fname);
 	}
 
 	int p_callcheck_magic(const Prog::Call& ca) const {
@@ -499,12 +629,14 @@ struct Parser : InputFile {
 		using Tokens::is_arraytype;
 		using Tokens::basetype;
 		// TODO: push and pop could take (string, int) if strings could be passed as references
+		// push, pop and default change their first argument, so it can't be a call result
+		auto temp = [&](size_t i) { return prog.exprs.at(ca.args.at(i).expr).temp(); };
 		if (ca.fname == "push") {
-			if (ca.args.size() == 2 && is_arraytype(ca.args[0].type) && basetype(ca.args[0].type) == ca.args[1].type)  return 1;
+			if (ca.args.size() == 2 && is_arraytype(ca.args[0].type) && basetype(ca.args[0].type) == ca.args[1].type && !temp(0))  return 1;
 			throw errordsym("incorrect arguments in push", ca.dsym);
 		}
 		else if (ca.fname == "pop") {
-			if (ca.args.size() == 1 && is_arraytype(ca.args[0].type))  return 1;
+			if (ca.args.size() == 1 && is_arraytype(ca.args[0].type) && !temp(0))  return 1;
 			throw errordsym("incorrect arguments in pop", ca.dsym);
 		}
 		else if (ca.fname == "len") {
@@ -512,7 +644,7 @@ struct Parser : InputFile {
 			throw errordsym("incorrect arguments in len", ca.dsym);
 		}
 		else if (ca.fname == "default") {
-			if (ca.args.size() == 1 && ca.args[0].type != "int")  return 1;
+			if (ca.args.size() == 1 && ca.args[0].type != "int" && !temp(0))  return 1;
 			throw errordsym("incorrect arguments in default", ca.dsym);
 		}
 		return 0;
@@ -544,7 +676,7 @@ struct Parser : InputFile {
 			if (ex.type != "int")  throw error("expected int inside or", ex.type);
 			p_expr_and(ex);
 			if (ex.type != "int")  throw error("expected int inside or", ex.type);
-			ex.instr.push_back({ "or" });
+			ex.instr.push_back({ Cmd::or_ });
 		}
 	}
 
@@ -554,7 +686,7 @@ struct Parser : InputFile {
 			if (ex.type != "int")  throw error("expected int inside and", ex.type);
 			p_expr_compare(ex);
 			if (ex.type != "int")  throw error("expected int inside and", ex.type);
-			ex.instr.push_back({ "and" });
+			ex.instr.push_back({ Cmd::and_ });
 		}
 	}
 
@@ -563,19 +695,20 @@ struct Parser : InputFile {
 		if (expect("`= `=") || expect("`! `=") || expect("`< `=") || expect("`> `=") || expect("`<") || expect("`>")) {
 			auto type = ex.type;  // cache expression type
 			if (type != "int" && type != "string")        throw error("cannot compare type", type);
-			string opcode, op = Strings::join(lastrule, "");
+			Cmd    opcode = Cmd::noop;
+			string op     = Strings::join(lastrule, "");
 			p_expr_add(ex);
 			// identify proper opcode
 			if      (type != ex.type)                     throw error("compare type mismatch");
-			else if (type == "string" && op == "==")      opcode = "eq_str";
-			else if (type == "string" && op == "!=")      opcode = "neq_str";
+			else if (type == "string" && op == "==")      opcode = Cmd::eq_str;
+			else if (type == "string" && op == "!=")      opcode = Cmd::neq_str;
 			else if (type == "string")                    throw error("cannot do comparison on string", op);
-			else if (op == "==")                          opcode = "eq";
-			else if (op == "!=")                          opcode = "neq";
-			else if (op == "<")                           opcode = "lt";
-			else if (op == ">")                           opcode = "gt";
-			else if (op == "<=")                          opcode = "lte";
-			else if (op == ">=")                          opcode = "gte";
+			else if (op == "==")                          opcode = Cmd::eq;
+			else if (op == "!=")                          opcode = Cmd::neq;
+			else if (op == "<")                           opcode = Cmd::lt;
+			else if (op == ">")                           opcode = Cmd::gt;
+			else if (op == "<=")                          opcode = Cmd::lte;
+			else if (op == ">=")                          opcode = Cmd::gte;
 			// emit command
 			ex.instr.push_back({ opcode });
 			ex.type = "int";
@@ -591,9 +724,9 @@ struct Parser : InputFile {
 			p_expr_mul(ex);
 			// identify proper opcode
 			if      (type != ex.type)                  throw error("add type mismatch");
-			else if (type == "int"    && op == "+")    ex.instr.push_back({ "add" });
-			else if (type == "int"    && op == "-")    ex.instr.push_back({ "sub" });
-			else if (type == "string" && op == "+")    ex.instr.push_back({ "strcat" });
+			else if (type == "int"    && op == "+")    ex.instr.push_back({ Cmd::add });
+			else if (type == "int"    && op == "-")    ex.instr.push_back({ Cmd::sub });
+			else if (type == "string" && op == "+")    ex.instr.push_back({ Cmd::strcat });
 			else if (type == "string" && op == "-")    throw error("cannot subtract strings");
 		}
 	}
@@ -605,30 +738,32 @@ struct Parser : InputFile {
 			string op = lasttok;
 			p_expr_atom(ex);
 			if      (ex.type != "int")    throw error("expected int inside multiply", ex.type);
-			else if (op == "*")           ex.instr.push_back({ "mul" });
-			else if (op == "/")           ex.instr.push_back({ "div" });
+			else if (op == "*")           ex.instr.push_back({ Cmd::mul });
+			else if (op == "/")           ex.instr.push_back({ Cmd::div });
 		}
 	}
 
 	void p_expr_atom(Prog::Expr& ex) {
 		if (peek("@sign") || peek("@integer"))
-			ex.instr.push_back({ "i",     p_integer() }),
+			ex.instr.push_back({ Cmd::i,     p_integer() }),
 			ex.type = "int";
 		else if (expect("true") || expect("false"))
-			ex.instr.push_back({ "i",     lasttok == "true" }),
+			ex.instr.push_back({ Cmd::i,     lasttok == "true" }),
 			ex.type = "int";
 		else if (peek("@literal"))
-			ex.instr.push_back({ "lit",   p_literal() }),
+			ex.instr.push_back({ Cmd::lit,   p_literal() }),
 			ex.type = "string";
-		else if (peek("@identifier ("))
-			ex.instr.push_back({ "call",  p_call() }),
-			ex.type = "int";
+		else if (peek("@identifier (") || peek("@identifier :")) {
+			int cap = p_call();
+			ex.instr.push_back({ Cmd::call,  cap });
+			ex.type = prog.calls.at(cap).type;
+		}
 		else if (peek("@identifier")) {
 			int vpp = p_varpath_any();
 			ex.type = prog.varpaths.at(vpp).type;
-			if      (ex.type == "int")     ex.instr.push_back({ "varpath",     vpp });
-			else if (ex.type == "string")  ex.instr.push_back({ "varpath_str", vpp });
-			else    ex.instr.push_back({ "varpath_ptr", vpp });
+			if      (ex.type == "int")     ex.instr.push_back({ Cmd::varpath,     vpp });
+			else if (ex.type == "string")  ex.instr.push_back({ Cmd::varpath_str, vpp });
+			else    ex.instr.push_back({ Cmd::varpath_ptr, vpp });
 		}
 		else if (expect("("))
 			p_expr_or(ex),
@@ -657,12 +792,7 @@ struct Parser : InputFile {
 
 	// TODO: better name for this?
 	int p_addliteral(const string& s) {
-		auto lit = Strings::deliteral( s );
-		// de-duplicate
-		for (int i = 0; i < prog.literals.size(); i++)
-			if (prog.literals[i] == lit)  return i;
-		prog.literals.push_back(lit);
-		return prog.literals.size() - 1;
+		return prog.literals.intern( Strings::deliteral(s) );  // de-duplicated
 	}
 
 };  // end Parser
\ No newline at end of file
@@ -0,0 +1,185 @@
+// ----------------------------------------
+// Line profiler
+// ----------------------------------------
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <atomic>
+#include <cstdio>
+#include <sys/time.h>
+#include "dbas7.hpp"
+#include "inputfile.hpp"
+using namespace std;
+
+
+// Counts statement runs and wall-clock time per source line (Prog::Dsym), and calls and time per
+// function. A line's clock runs from its start to the start of the next one, so times are self
+// times, and a call's time is charged to the callee's lines. A SIGPROF timer samples the current
+// line on CPU time alongside: the signal handler only bumps a lock-free counter, and the
+// interpreter adds the pending samples to the line that was running when it next changes
+// lines. Line 0 of file 0 holds everything outside a statement.
+struct Profiler {
+	struct Line  { int64_t count, ns, samples; };
+	struct Func  { int64_t calls, ns, selfns; int32_t depth; };  // ns: inclusive, of the outermost calls
+	struct Frame { int32_t fidx; Prog::Dsym ret; int64_t t0; };
+	typedef  chrono::steady_clock  clock;
+	static const int SAMPLE_US = 1000;
+
+	vector<dvec<Line>> lines;  // by file, by line number. dvec: cur stays valid as files grow
+	vector<Func>       funcs;  // by Prog::functions index
+	vector<Frame>      fstack;
+	Line*              cur = NULL;
+	Prog::Dsym         curd = { 0, 0 };
+	int32_t            cfn = -1;
+	int64_t            last = 0;
+	static inline atomic<int32_t> pending{0};  // samples taken since the last tick
+	static_assert(atomic<int32_t>::is_always_lock_free, "sample counter must be safe in a signal handler");
+
+
+	// === collect ===
+
+	static int64_t now() {
+		return chrono::duration_cast<chrono::nanoseconds>( clock::now().time_since_epoch() ).count();
+	}
+	Line& at(Prog::Dsym d) {
+		auto& ls = lines.at(d.fno);
+		while (ls.size() <= (size_t)d.lno)  ls.push_back({});
+		return ls[d.lno];
+	}
+	void tick(int64_t t) {
+		if (pending.load(memory_order_relaxed))  cur->samples += pending.exchange(0, memory_order_relaxed);
+		cur->ns += t - last;
+		if (cfn > -1)  funcs[cfn].selfns += t - last;
+		last = t;
+	}
+
+	void start(const Prog& prog) {
+		lines = vector<dvec<Line>>( prog.files.size() + 1 );
+		funcs = vector<Func>( prog.functions.size() );
+		fstack = {},  cfn = -1,  curd = { 0, 0 },  cur = &at(curd);
+		last = now();
+		pending = 0;
+		struct sigaction sa = {};
+		sa.sa_handler = [](int) { pending.fetch_add(1, memory_order_relaxed); };
+		sa.sa_flags   = SA_RESTART;  // don't break input waits
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGPROF, &sa, NULL);
+		itimerval it = { { 0, SAMPLE_US }, { 0, SAMPLE_US } };
+		setitimer(ITIMER_PROF, &it, NULL);
+	}
+	void stop() {
+		itimerval it = {};
+		setitimer(ITIMER_PROF, &it, NULL);
+		struct sigaction sa = {};
+		sa.sa_handler = SIG_DFL;
+		sigaction(SIGPROF, &sa, NULL);
+		tick(now());
+	}
+
+	// a statement starts
+	void line(Prog::Dsym d) {
+		tick(now());
+		curd = d,  cur = &at(d);
+		cur->count++;
+	}
+	// function fidx is called. frame setup is charged to its own line
+	void enter(int32_t fidx, Prog::Dsym d) {
+		int64_t t = now();
+		tick(t);
+		fstack.push_back({ cfn, curd, t });
+		cfn = fidx,  funcs[fidx].calls++,  funcs[fidx].depth++;
+		curd = d,  cur = &at(d);
+		cur->count++;
+	}
+	// its frame is torn down, charged to its line too
+	void unwind(Prog::Dsym d) {
+		tick(now());
+		curd = d,  cur = &at(d);
+	}
+	// and it returns to the caller's line
+	void leave() {
+		int64_t t = now();
+		tick(t);
+		auto fr = fstack.back();
+		fstack.pop_back();
+		if (--funcs[cfn].depth == 0)  funcs[cfn].ns += t - fr.t0;  // recursion: outermost call only
+		cfn = fr.fidx,  curd = fr.ret,  cur = &at(curd);
+	}
+
+
+	// === report ===
+
+	static vector<string> sourcelines(const string& fname) {
+		vector<string> ls;
+		MappedFile m;
+		if (m.open(fname))  return ls;
+		auto src = m.view();
+		for (size_t i = 0; i < src.size(); ) {
+			size_t j = src.find('\n', i);
+			if (j == string_view::npos)  j = src.size();
+			ls.push_back(string( src.substr(i, j - i) ));
+			i = j + 1;
+		}
+		return ls;
+	}
+	static string trim(const string& s) {
+		size_t a = s.find_first_not_of(" \t");
+		return a == string::npos ? "" : s.substr(a);
+	}
+
+	// hot-spot tables: lines and functions by self time
+	void show(const Prog& prog, size_t top=15) {
+		struct Hot { Prog::Dsym d; const Line* l; };
+		vector<Hot> hot;
+		int64_t total = 0,  samples = 0;
+		for (size_t f = 0; f < lines.size(); f++)
+			for (size_t l = 0; l < lines[f].size(); l++) {
+				total += lines[f][l].ns,  samples += lines[f][l].samples;
+				if (f > 0 && (lines[f][l].count || lines[f][l].samples))  hot.push_back({ { (int32_t)l, (int32_t)f }, &lines[f][l] });
+			}
+		sort(hot.begin(), hot.end(), [](const Hot& a, const Hot& b) { return a.l->ns > b.l->ns; });
+		vector<vector<string>> src( prog.files.size() );
+		for (size_t f = 0; f < prog.files.size(); f++)  src[f] = sourcelines(prog.files[f]);
+		printf("  profile: %.3f ms, %lld samples\n", total / 1e6, (long long)samples);
+		printf("    %10s %6s %10s %7s  %s\n", "self ms", "%", "count", "samples", "line");
+		for (size_t i = 0; i < hot.size() && i < top; i++) {
+			auto& h = hot[i];
+			auto& fs = src.at(h.d.fno - 1);
+			printf("    %10.3f %5.1f%% %10lld %7lld  %s:%d  %s\n", h.l->ns / 1e6, total ? 100.0 * h.l->ns / total : 0.0,
+				(long long)h.l->count, (long long)h.l->samples, prog.files[h.d.fno - 1].c_str(), h.d.lno,
+				(size_t)h.d.lno - 1 < fs.size() ? trim(fs[h.d.lno - 1]).c_str() : "");
+		}
+		vector<int32_t> fns;
+		for (size_t i = 0; i < funcs.size(); i++)
+			if (funcs[i].calls)  fns.push_back(i);
+		sort(fns.begin(), fns.end(), [&](int32_t a, int32_t b) { return funcs[a].selfns > funcs[b].selfns; });
+		printf("    %10s %10s %10s  %s\n", "self ms", "total ms", "calls", "function");
+		for (size_t i = 0; i < fns.size() && i < top; i++) {
+			auto& fn = funcs[fns[i]];
+			printf("    %10.3f %10.3f %10lld  %s\n", fn.selfns / 1e6, fn.ns / 1e6, (long long)fn.calls, prog.functions[fns[i]].name.c_str());
+		}
+	}
+
+	// annotated source listing of every file
+	int tofile(const Prog& prog, const string& fname) {
+		FILE* fp = fopen(fname.c_str(), "w");
+		if (!fp)  return fprintf(stderr, "could not open file: %s\n", fname.c_str()), 1;
+		for (size_t f = 0; f < prog.files.size(); f++) {
+			fprintf(fp, "%s\n%10s %10s %7s\n", prog.files[f].c_str(), "count", "self ms", "samples");
+			auto src = sourcelines(prog.files[f]);
+			auto& ls = lines.at(f + 1);
+			for (size_t l = 1; l <= src.size(); l++)
+				if    (l < ls.size() && (ls[l].count || ls[l].samples))
+					fprintf(fp, "%10lld %10.3f %7lld | %s\n", (long long)ls[l].count, ls[l].ns / 1e6, (long long)ls[l].samples, src[l - 1].c_str());
+				else  fprintf(fp, "%10s %10s %7s | %s\n", "", "", "", src[l - 1].c_str());
+			fprintf(fp, "\n");
+		}
+		fclose(fp);
+		printf("wrote profile to: %s\n", fname.c_str());
+		return 0;
+	}
+};
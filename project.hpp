@@ -0,0 +1,362 @@
+// ----------------------------------------
+// Multi-file projects
+// ----------------------------------------
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include "dbas7.hpp"
+#include "parser.hpp"
+using namespace std;
+
+
+// A project is a list of source files. Each file is parsed on its own, by its own Parser and
+// symbol tables, on a pool of threads. The link step then merges them into one Prog in list order,
+// so the result never depends on thread timing.
+// Types and globals are file scope. Functions are module scope: files without a module line make up
+// the "default" (program) module, and functions of any other module are named and called module:f.
+//
+// Files are parsed in units: the header (module, types, globals), then one unit per function. With
+// incremental set, the parse of each file is kept between builds, and a rebuild only re-parses the
+// units whose source text changed. Unchanged units are moved over from the last build. A changed
+// header re-parses the whole file, as globals and types are resolved to slots while parsing.
+// Calls are typed by the return types of the functions they call, so every file is prescanned for
+// those before any is parsed. A change to any return type re-parses everything.
+struct Project {
+	// table sizes, or a range of indexes into each table
+	struct Range { int32_t globals, functions, blocks, prints, inputs, ifs, whiles, fors, lets, varpaths, exprs, calls; };
+	// parse state kept between builds, per file
+	struct Unit   { size_t hash; int32_t lno; Range begin, end; int fresh; };  // fresh: call sites not yet checked
+	struct Source { size_t hash = 0; unique_ptr<Parser> p, next; vector<Unit> units; int32_t parsed = 0; unordered_map<string, string> rets; };  // next: loaded, to parse
+
+	vector<string> files;
+	int            threads = 0;      // parser threads. 0: one per core
+	int            incremental = 0;  // keep parse state for the next build
+	Prog           prog;             // linked program
+	size_t         lines = 0;        // source lines
+	int32_t        units = 0,  parsed = 0;  // units in the project, and units parsed by the last build
+	unordered_map<string, Source>  sources;
+	unordered_map<string, string>  sigs;  // function -> argument and return types, at the last link
+	unordered_map<string, string>  rets;  // function -> return type, project-wide (Parser::p_prescan)
+
+	void build() {
+		parse_all();
+		link();
+	}
+
+
+
+// --- Parse ---
+
+	void parse_all() {
+		vector<Source*> srcs;
+		for (auto it = sources.begin(); it != sources.end(); )  // forget files dropped from the project
+			it = find(files.begin(), files.end(), it->first) == files.end() ? sources.erase(it) : next(it);
+		for (auto& f : files)
+			srcs.push_back(&sources[f]);
+		// load changed files, and collect the return types of all functions
+		parallel(srcs, [&](size_t i) { load_file(*srcs[i], files[i]); });
+		unordered_map<string, string> nrets;
+		for (auto st : srcs)
+			nrets.insert(st->rets.begin(), st->rets.end());
+		if (nrets != rets)  // calls in the units kept from the last build may be typed wrong now
+			for (size_t i = 0; i < files.size(); i++) {
+				srcs[i]->units.clear();
+				if (!srcs[i]->next)  srcs[i]->hash = 0,  load_file(*srcs[i], files[i]);
+			}
+		rets = move(nrets);
+		// parse
+		parallel(srcs, [&](size_t i) { parse_file(*srcs[i], rets); });
+		lines = units = parsed = 0;
+		for (auto st : srcs)
+			lines += st->p->lines.size(),  units += st->units.size(),  parsed += st->parsed;
+	}
+
+	// run job(i) for each file on a pool of threads. a failed file starts over next build
+	void parallel(vector<Source*>& srcs, const function<void(size_t)>& job) {
+		vector<string> errors( files.size() );
+		atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i; (i = next++) < files.size(); )
+				try {
+					job(i);
+				}
+				catch (exception& e) {
+					*srcs[i] = {};
+					errors[i] = files[i] + ": " + e.what();
+				}
+		};
+		size_t n = threads > 0 ? threads : max(1u, thread::hardware_concurrency());
+		vector<thread> pool;
+		for (size_t t = 1; t < min(n, files.size()); t++)
+			pool.emplace_back(worker);
+		worker();  // this thread takes a share too
+		for (auto& t : pool)  t.join();
+		// report the first error in file order, not the first to happen
+		for (auto& err : errors)
+			if (err.size())  throw InputFile::parse_error(err);
+	}
+
+	// load and prescan a file, unless it is unchanged since the last build
+	static void load_file(Source& st, const string& fname) {
+		MappedFile m;
+		if (m.open(fname))  throw runtime_error("could not load file");
+		size_t fhash = hash<string_view>()( m.view() );
+		st.parsed = 0;
+		if (st.p && st.hash == fhash)  return;
+		auto p = make_unique<Parser>();
+		p->quiet = 1;
+		if (p->load(fname))  throw runtime_error("could not load file");
+		p->p_prescan();
+		st.hash = fhash,  st.rets = p->sym_rets,  st.next = move(p);
+	}
+
+	// parse a loaded file, moving over the units that did not change since the last build
+	static void parse_file(Source& st, const unordered_map<string, string>& rets) {
+		if (!st.next)  return;
+		auto p = move(st.next);
+		p->proj_rets = &rets;
+		// unit bounds: each function runs up to the next one
+		vector<int32_t> bounds = { 0 };
+		for (int32_t l = 0; l < (int32_t)p->lines.size(); l++)
+			if (p->linetok[l] < p->linetok[l+1] && p->toks[ p->linetok[l] ].text == "function")  bounds.push_back(l);
+		bounds.push_back(p->lines.size());
+		auto src      = p->srcmap.view();
+		auto offset   = [&](int32_t l) -> size_t { return l < (int32_t)p->lines.size() ? p->lines[l].data() - src.data() : src.size(); };
+		auto unithash = [&](int32_t a, int32_t b) { return hash<string_view>()( src.substr(offset(a), offset(b) - offset(a)) ); };
+
+		// header
+		Prog old;
+		vector<Unit> units = { { unithash(0, bounds[1]), 0, sizes(p->prog), {}, 1 } };
+		int keep = st.p && st.units.size() && st.units[0].hash == units[0].hash;
+		if (st.p)  old = move(st.p->prog);
+		if (keep) {
+			p->sym_types   = move(st.p->sym_types);
+			p->sym_globals = move(st.p->sym_globals);
+			p->sym_members = move(st.p->sym_members);
+			p->prog.module = old.module,  p->prog.files = old.files,  p->prog.types = move(old.types);
+			append(p->prog, old, st.units[0].begin, st.units[0].end, 0, 0);
+			units[0].fresh = st.units[0].fresh;
+		}
+		else
+			p->p_header(),  endunit(*p, bounds[1]),  st.parsed++;
+		units[0].end = sizes(p->prog);
+
+		// functions, matched to the last build by source text
+		unordered_map<size_t, int32_t> olds;
+		for (size_t u = 1; keep && u < st.units.size(); u++)
+			olds.emplace(st.units[u].hash, u);
+		for (size_t b = 1; b + 1 < bounds.size(); b++) {
+			Unit un = { unithash(bounds[b], bounds[b+1]), bounds[b], sizes(p->prog), {}, 1 };
+			auto it = olds.find(un.hash);
+			if (it != olds.end()) {
+				const auto& ou = st.units[it->second];
+				append(p->prog, old, ou.begin, ou.end, un.lno - ou.lno, 0);
+				un.fresh = ou.fresh;
+				olds.erase(it);
+				auto& fn = p->prog.functions.back();
+				if (p->is_func(fn.name))  throw p->errordsym("function name collision: " + fn.name, fn.dsym);
+				p->sym_funcs.emplace(fn.name, p->prog.functions.size() - 1);
+			}
+			else {
+				p->lno = un.lno,  p->tokenizeline();
+				p->p_function();
+				endunit(*p, bounds[b+1]);
+				st.parsed++;
+			}
+			un.end = sizes(p->prog);
+			units.push_back(un);
+		}
+		st.p = move(p),  st.units = move(units);
+	}
+
+	// only blank lines and comments may follow a unit
+	static void endunit(Parser& p, int32_t end) {
+		while (p.lno < end && p.expect("@endl"))  p.nextline();
+		if (p.lno != end)  throw p.error("unexpected command", p.currenttoken());
+	}
+
+
+
+// --- Link ---
+
+	void link() {
+		Parser lk;  // symbol tables for the whole project, and the call checks
+		lk.prog.module = "default";
+		vector<uint8_t> check;  // call sites in re-parsed units
+		for (auto& f : files) {
+			auto&   st   = sources.at(f);
+			int32_t base = lk.prog.calls.size();
+			if (incremental)  { Prog p = st.p->prog;  merge(lk, p); }
+			else              merge(lk, st.p->prog);
+			check.resize(lk.prog.calls.size(), 0);
+			for (auto& u : st.units)
+				if (u.fresh)  fill(check.begin() + base + u.begin.calls, check.begin() + base + u.end.calls, 1);
+		}
+		// other call sites only need checking if the function they call changed its arguments
+		unordered_map<string, string> nsigs;
+		for (auto& fn : lk.prog.functions) {
+			string sig;
+			for (auto& a : fn.args)  sig += a.type + ",";
+			nsigs.emplace(fn.name, sig + ")" + fn.type);
+		}
+		auto changed = [&](const string& fname) {
+			auto a = sigs.find(fname),  b = nsigs.find(fname);
+			return !Parser::is_sysfunc(fname) && (a == sigs.end() || b == nsigs.end() || a->second != b->second);
+		};
+		for (size_t i = 0; i < lk.prog.calls.size(); i++)
+			if (check[i] || changed(lk.prog.calls[i].fname))  lk.p_callcheck( lk.prog.calls[i] );
+		lk.p_link();
+		prog = move(lk.prog);
+		// checked: keep what the next build needs
+		if (!incremental)  sources.clear(),  sigs.clear();
+		else {
+			sigs = move(nsigs);
+			for (auto& f : files)
+				for (auto& u : sources.at(f).units)  u.fresh = 0;
+		}
+	}
+
+	// append one file's program
+	static void merge(Parser& lk, Prog& p) {
+		Prog&         out = lk.prog;
+		const int32_t fno = out.files.size();
+		const Range   o   = sizes(out);
+		for (auto& f : p.files)
+			out.files.push_back(f);
+		// types are found by name at runtime, so one name must mean one layout project-wide
+		for (auto& t : p.types) {
+			int32_t ti = Parser::symfind(lk.sym_types, t.name);
+			if (ti == -1) {
+				for (auto& m : t.members)  m.dsym.fno += fno;
+				lk.sym_types.emplace(t.name, out.types.size());
+				out.types.push_back(move(t));
+				continue;
+			}
+			const auto& ot = out.types[ti];
+			int same = ot.members.size() == t.members.size();
+			for (size_t i = 0; same && i < t.members.size(); i++)
+				same = ot.members[i].name == t.members[i].name && ot.members[i].type == t.members[i].type;
+			if (!same)  throw InputFile::parse_error("type redefined with different members: " + t.name + " . " + p.files.at(0));
+		}
+		append(out, p, {}, sizes(p), 0, fno);
+		for (int32_t i = o.functions; i < (int32_t)out.functions.size(); i++) {
+			auto& fn = out.functions[i];
+			fn.name = Parser::linkname(p.module, fn.name);
+			if (lk.is_func(fn.name))  throw lk.errordsym("function redefined: " + fn.name, fn.dsym);
+			lk.sym_funcs.emplace(fn.name, i);
+		}
+		// calls: f is the caller's own module, mod:f another one, default:f the program
+		for (int32_t i = o.calls; i < (int32_t)out.calls.size(); i++) {
+			auto& ca = out.calls[i];
+			ca.fname = Parser::linkname(p.module, ca.fname);
+		}
+	}
+
+
+
+// --- Relocation ---
+
+	static Range sizes(const Prog& p) {
+		return { (int32_t)p.globals.size(), (int32_t)p.functions.size(), (int32_t)p.blocks.size(), (int32_t)p.prints.size(),
+			(int32_t)p.inputs.size(), (int32_t)p.ifs.size(), (int32_t)p.whiles.size(), (int32_t)p.fors.size(),
+			(int32_t)p.lets.size(), (int32_t)p.varpaths.size(), (int32_t)p.exprs.size(), (int32_t)p.calls.size() };
+	}
+
+	// move the nodes [from, to) of each src table onto the end of out, shifting the indexes inside them to
+	// match. debug symbols move by dlno lines and dfno files. types are not moved: callers merge them by name
+	static void append(Prog& out, Prog& src, const Range& from, const Range& to, int32_t dlno, int32_t dfno) {
+		const Range o = sizes(out);
+		const Range d = { o.globals - from.globals, o.functions - from.functions, o.blocks - from.blocks, o.prints - from.prints,
+			o.inputs - from.inputs, o.ifs - from.ifs, o.whiles - from.whiles, o.fors - from.fors,
+			o.lets - from.lets, o.varpaths - from.varpaths, o.exprs - from.exprs, o.calls - from.calls };
+		auto expr  = [&](int& ex)  { if (ex > -1)  ex += d.exprs; };
+		auto dsym  = [&](Prog::Dsym& ds)  { ds.lno += dlno,  ds.fno += dfno; };
+		auto dim   = [&](Prog::Dim& dm)  { expr(dm.expr),  dsym(dm.dsym); };
+		auto instr = [&](vector<Prog::Instruction>& instr) {
+			for (auto& in : instr)
+				switch (in.cmd) {
+				case Cmd::varpath:  case Cmd::varpath_str:  case Cmd::varpath_ptr:  in.iarg += d.varpaths;  break;
+				case Cmd::lit:  case Cmd::literal:  in.iarg = out.literals.intern( src.literals[in.iarg] );  break;
+				case Cmd::get_global:  in.iarg += d.globals;  break;
+				case Cmd::memget_expr:  case Cmd::memget_chr:  case Cmd::expr:  case Cmd::expr_str:  in.iarg += d.exprs;  break;
+				case Cmd::call:  in.iarg += d.calls;  break;
+				default:  break;  // values, frame slots, member indexes
+				}
+		};
+
+		for (int32_t i = from.globals; i < to.globals; i++) {
+			auto& g = src.globals[i];
+			dim(g),  out.globals.push_back(move(g));
+		}
+		for (int32_t i = from.functions; i < to.functions; i++) {
+			auto& fn = src.functions[i];
+			fn.block += d.blocks,  dsym(fn.dsym);
+			for (auto& dm : fn.args)    dim(dm);
+			for (auto& dm : fn.locals)  dim(dm);
+			out.functions.push_back(move(fn));
+		}
+		for (int32_t i = from.blocks; i < to.blocks; i++) {
+			auto& bl = src.blocks[i];
+			for (auto& st : bl.statements) {
+				dsym(st.dsym);
+				switch (st.type) {
+				case Stmt::print:    st.loc += d.prints;  break;
+				case Stmt::input:    st.loc += d.inputs;  break;
+				case Stmt::if_:      st.loc += d.ifs;  break;
+				case Stmt::while_:   st.loc += d.whiles;  break;
+				case Stmt::for_:     st.loc += d.fors;  break;
+				case Stmt::return_:  expr(st.loc);  break;
+				case Stmt::let:      st.loc += d.lets;  break;
+				case Stmt::call:     st.loc += d.calls;  break;
+				default:  break;  // break / continue levels
+				}
+			}
+			out.blocks.push_back(move(bl));
+		}
+		for (int32_t i = from.prints; i < to.prints; i++) {
+			auto& pr = src.prints[i];
+			instr(pr.instr),  out.prints.push_back(move(pr));
+		}
+		for (int32_t i = from.inputs; i < to.inputs; i++) {
+			auto& in = src.inputs[i];
+			in.varpath += d.varpaths,  out.inputs.push_back(move(in));
+		}
+		for (int32_t i = from.ifs; i < to.ifs; i++) {
+			auto& ii = src.ifs[i];
+			for (auto& c : ii.conds)  expr(c.expr),  c.block += d.blocks;
+			out.ifs.push_back(move(ii));
+		}
+		for (int32_t i = from.whiles; i < to.whiles; i++) {
+			auto& wh = src.whiles[i];
+			expr(wh.expr),  wh.block += d.blocks,  out.whiles.push_back(move(wh));
+		}
+		for (int32_t i = from.fors; i < to.fors; i++) {
+			auto& fo = src.fors[i];
+			fo.varpath += d.varpaths,  expr(fo.start_expr),  expr(fo.end_expr),  fo.block += d.blocks,  out.fors.push_back(move(fo));
+		}
+		for (int32_t i = from.lets; i < to.lets; i++) {
+			auto& let = src.lets[i];
+			let.varpath += d.varpaths,  expr(let.expr),  out.lets.push_back(move(let));
+		}
+		for (int32_t i = from.varpaths; i < to.varpaths; i++) {
+			auto& vp = src.varpaths[i];
+			instr(vp.instr),  out.varpaths.push_back(move(vp));
+		}
+		for (int32_t i = from.exprs; i < to.exprs; i++) {
+			auto& ex = src.exprs[i];
+			instr(ex.instr),  out.exprs.push_back(move(ex));
+		}
+		for (int32_t i = from.calls; i < to.calls; i++) {
+			auto& ca = src.calls[i];
+			for (auto& a : ca.args)  expr(a.expr);
+			dsym(ca.dsym),  out.calls.push_back(move(ca));
+		}
+	}
+};
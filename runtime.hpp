@@ -3,35 +3,57 @@
 // ----------------------------------------
 #pragma once
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <string_view>
 #include <stdexcept>
 #include <cassert>
 #include "dbas7.hpp"
+#include "heap.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "census.hpp"
 using namespace std;
 
 
 
 struct Runtime {
 	// structs
-	struct MemPage { string type; vector<int32_t> mem; };
+	typedef  Heap::MemPage  MemPage;
 	struct MemPtr  { int32_t ptr, off; string v; };
-	struct Var     { string type; int32_t v; };
-	typedef  map<string, Var>  StackFrame;
+	// reference to a variable: an int slot, or one byte of a string page
+	struct Ref {
+		int32_t* ptr;  char* chr;
+		int32_t get() const     { return ptr ? *ptr : *chr; }
+		void    set(int32_t v)  { if (ptr)  *ptr = v;  else  *chr = v; }
+	};
+	// expression stack value. strings are views of a literal or heap page, until an operation needs its own copy
+	struct Val {
+		enum Tag : int32_t { INT, LIT, HEAP, TMP } tag;
+		int32_t v;  // int, literal index or heap handle. TMP strings live in tmps, at the same position
+	};
 	typedef  int32_t  pos_t;
+	static const pos_t STACK_MAX = 1 << 20;  // value stack slots. fixed, so references into it stay valid
 	// errors
 	// struct DBRunError : runtime_error {};
-	struct ctrl_exception : exception      { int32_t val = 0;  ctrl_exception(int32_t _val) : val(_val) {} };
-	struct ctrl_return    : ctrl_exception { using ctrl_exception::ctrl_exception; };
-	struct ctrl_break     : ctrl_exception { using ctrl_exception::ctrl_exception; };
-	struct ctrl_continue  : ctrl_exception { using ctrl_exception::ctrl_exception; };
+	// control flow status, passed back up from block(). argument (rval / break-level) is in ctrl_val
+	enum Ctrl { CTRL_NONE = 0, CTRL_RETURN, CTRL_BREAK, CTRL_CONTINUE };
 	// state
-	map<string, int32_t>           consts;
-	map<int32_t, MemPage>          heap;
-	StackFrame                     globals;
-	vector<StackFrame>             fstack;
-	vector<int32_t>                istack;  // expression stack
-	vector<string>                 sstack;  // string expression stack
-	int32_t memtop = 0;
+	Heap                           heap;
+	vector<int32_t>                globals;  // global slots
+	vector<int32_t>                vstack;   // value stack. frames of argument + local slots
+	vector<pos_t>                  fstack;   // frame base offsets into vstack
+	int32_t                        ctrl_val = 0;
+	vector<Val>                    vals;     // expression stack
+	vector<string>                 tmps;     // owned strings by vals position. buffers are reused
+	int32_t                        nviews = 0;  // heap views on vals
+	vector<int32_t>                pins;     // containers of the objects passed by reference to the running calls
+	unordered_map<string, pos_t>   typeids;  // type name -> prog.types index, built by reset()
+	int                            profile = 0;  // collect a line profile into prof
+	Profiler                       prof;
+	int                            trace = 0;  // record calls and input waits into tracer, once started
+	Tracer                         tracer;
+	int                            census = 0;  // account heap use by call site into cen
+	Census                         cen;
 	// program source
 	Prog prog;
 
@@ -39,14 +61,9 @@ struct Runtime {
 
 // --- Helpers ---
 
-	int32_t getnum(const string& num) const {
-		try                         { return stoi(num); }
-		catch (invalid_argument& e) { return consts.at(num); }
-	}
 	pos_t typeindex(const string& name) const {
-		for (size_t i = 0; i < prog.types.size(); i++)
-			if (prog.types[i].name == name)  return i;
-		return -1;
+		auto it = typeids.find(name);
+		return it == typeids.end() ? -1 : it->second;
 	}
 	const Prog::Type& gettype(const string& name) const {
 		if (typeindex(name) == -1)  throw runtime_error("missing type: " + name);
@@ -57,37 +74,48 @@ struct Runtime {
 			if (prog.functions[i].name == name)  return i;
 		return -1;
 	}
-	const Prog::Function getfunc(const string& name) const {
-		for (auto& fn : prog.functions)
-			if (fn.name == name)  return fn;
-		throw runtime_error("missing function: " + name);
-	}
 
 
 
 // --- Main memory ---
 
-	StackFrame& ftop() {
+	pos_t ftop() const {
 		return fstack.at(fstack.size() - 1);
 	}
-	int32_t& get(string id) {
-		return ftop().at(id).v;
+	int32_t& get(pos_t slot) {
+		return vstack[ftop() + slot];
 	}
-	int32_t& get_global(string id) {
-		return globals.at(id).v;
+	int32_t& get_global(pos_t slot) {
+		return globals.at(slot);
+	}
+	pos_t frame_push(pos_t base, pos_t size) {
+		if (base + size > STACK_MAX)  throw runtime_error("stack overflow");
+		vstack.resize(base + size, 0);
+		fstack.push_back(base);
+		return base;
+	}
+	void frame_pop() {
+		vstack.resize(ftop());
+		fstack.pop_back();
 	}
 	int32_t& memget(int32_t ptr, int32_t off) {
 		return heap.at(ptr).mem.at(off);
 	}
+	char& memget_chr(int32_t ptr, int32_t off) {
+		return heap.at(ptr).str.at(off);
+	}
 	int32_t memsize(int32_t ptr) const {
-		return heap.at(ptr).mem.size();
+		const auto& page = heap.at(ptr);
+		return page.type == "string" ? page.str.size() : page.mem.size();
+	}
+	const string& memstr(int32_t ptr) const {
+		return heap.at(ptr).str;
 	}
 
 
 	// heap memory make
 	int32_t memalloc(string type, int32_t size) {
-		heap[++memtop] = { .type=type, .mem=vector<int32_t>(size, 0) };
-		return memtop;
+		return heap.alloc(type, size);
 	}
 	int32_t make(const string& type) {
 		if      (type == "int")               return 0;
@@ -102,90 +130,106 @@ struct Runtime {
 		}
 		else    throw runtime_error("make: unknown type: " + type);
 	}
-	int32_t make_str(const string& val) {
+	int32_t make_str(string_view val) {
 		int32_t ptr = memalloc("string", 0);
-		heap.at(ptr).mem.insert( heap.at(ptr).mem.end(), val.begin(), val.end() );
+		heap.at(ptr).str = val;
 		return ptr;
 	}
 
-	// heap memory clone
-	// TODO: clean up multiple clone functions
+	// heap memory clone. copies share the source's body until one of them is written to (memwrite)
 	int32_t clone2(const string& type, int32_t sptr, int32_t dptr=0) {
 		assert(!(type == "int" && dptr != 0));
 		if      (type == "int")  return sptr;  // raw int
-		else if (dptr == 0)      dptr = memalloc(heap.at(sptr).type, 0);  // cloning to empty memory
-		else                     unmake(dptr);  // cloning to existing memory
-		_clone(sptr, dptr);  // perform clone
+		else if (dptr == 0)      return clone(sptr);  // cloning to empty memory
+		cloneto(sptr, dptr);  // cloning to existing memory
 		return dptr;
 	}
-
 	int32_t clone(int32_t sptr) {
-		int32_t dptr = memalloc(heap.at(sptr).type, 0);
-		_clone(sptr, dptr);
-		return dptr;
+		if (!heap.pinned(sptr))  return heap.share(sptr);
+		// the copy takes the new handles, so a reference into sptr still writes to sptr only
+		auto&   src = heap.at(sptr);
+		int32_t t   = heap.alloc(src.type, 0);
+		auto&   dst = heap.at(t);
+		dst.mem = src.mem,  dst.str = src.str;
+		children(dst, [&](int32_t& p) { p = clone(p); });
+		return t;
 	}
 	void cloneto(int32_t sptr, int32_t dptr) {
+		if (heap.same(sptr, dptr))  return;
+		int32_t t = clone(sptr);  // hold the source, which may be a child of dptr
 		unmake(dptr);
-		_clone(sptr, dptr);
+		heap.rebind(dptr, t);
+		heap.free(t);
 	}
-	void clonestr(string s, int32_t dptr) {
+	// move a call's result into dptr: its body is taken over, and the temporary page dropped
+	void moveto(int32_t sptr, int32_t dptr) {
+		cloneto(sptr, dptr);
+		destroy(sptr);
+	}
+	void clonestr(string_view s, int32_t dptr) {
 		assert(heap.at(dptr).type == "string");
-		heap.at(dptr).mem = {};
-		heap.at(dptr).mem.insert( heap.at(dptr).mem.end(), s.begin(), s.end() );
-	}
-	void _clone(int32_t sptr, int32_t dptr) {
-		// TODO: is this memory safe?
-		auto& spage = heap.at(sptr);
-		auto& dpage = heap.at(dptr);
-		// assert(dpage.mem.size() > 0);  // TODO: why?
-		assert(spage.type == dpage.type);
-		// linear memory
-		if (spage.type == "string" || spage.type == "int[]")
-			dpage.mem = spage.mem;
-		// objects
-		else if (typeindex(spage.type) > -1) {
-			auto& t = gettype(spage.type);
-			assert(spage.mem.size() == t.members.size());
-			dpage.mem.resize(spage.mem.size(), 0);
+		auto& body = heap.body(dptr);
+		if    (body.refs > 1)  heap.detach(dptr),  heap.at(dptr).str = s;  // s may view the old body, which the other pages keep alive
+		else  body.page.str = s;
+	}
+	void appendstr(string_view s, int32_t dptr) {
+		assert(heap.at(dptr).type == "string");
+		memwrite(dptr).str += s;  // amortized O(1) per character; s may view dptr itself
+	}
+	// page contents for writing. a shared body is copied first, and the copy takes its own
+	// (still shared) handles to the child pages, so writes below it are copied in turn
+	MemPage& memwrite(int32_t ptr) {
+		auto& body = heap.body(ptr);
+		if (body.refs <= 1)  return body.page;
+		auto& page = heap.unshare(ptr);
+		children(page, [&](int32_t& p) { p = heap.share(p); });
+		return page;
+	}
+	// f(handle) for each page the page holds
+	template <typename F>
+	void children(MemPage& page, F f) {
+		if (page.type == "int[]" || page.type == "string") ;
+		else if (typeindex(page.type) > -1) {
+			auto& t = gettype(page.type);
 			for (size_t i = 0; i < t.members.size(); i++)
-				if    (t.members[i].type == "int")  dpage.mem[i] = spage.mem[i];
-				else  dpage.mem[i] = clone(spage.mem[i]);
-		}
-		// arrays
-		else if (Tokens::is_arraytype(spage.type)) {
-			dpage.mem.resize(spage.mem.size(), 0);
-			for (size_t i = 0; i < spage.mem.size(); i++)
-				dpage.mem[i] = clone(spage.mem[i]);
+				if (t.members[i].type != "int")
+					f(page.mem.at(i));
 		}
-		else    throw runtime_error("clone: unknown type: " + spage.type);
+		else if (Tokens::is_arraytype(page.type))
+			for (auto& p : page.mem)
+				f(p);
+		else  throw runtime_error("unknown type: " + page.type);
+	}
+	// pages along a by-reference argument's path stay pinned until the call returns (Heap::pin)
+	void pin(int32_t ptr) {
+		heap.pin(ptr),  pins.push_back(ptr);
+	}
+	void unpin(size_t n) {
+		while (pins.size() > n)  heap.unpin(pins.back()),  pins.pop_back();
 	}
 
 	// heap memory erase
 	void destroy(int32_t ptr) {
-		unmake(ptr);
-		heap.erase(ptr);
+		auto& body = heap.body(ptr);
+		if (body.refs <= 1)  unmake(body.page);  // last page on this body: destroy its children too
+		heap.free(ptr);
 	}
 	void unmake(int32_t ptr) {
-		auto& page = heap.at(ptr);
+		auto& body = heap.body(ptr);
+		if    (body.refs > 1)  heap.detach(ptr);  // the other pages keep the contents
+		else  unmake(body.page);
+	}
+	void unmake(MemPage& page) {
 		// printf("unmaking %s\n", page.type.c_str() );
-		if (page.type == "int[]" || page.type == "string") ;
-		else if (typeindex(page.type) > -1) {
-			auto& t = gettype(page.type);
-			for (size_t i = 0; i < t.members.size(); i++)
-				if (t.members[i].type != "int")
-					destroy(page.mem.at(i));
-		}
-		else if (Tokens::is_arraytype(page.type))
-			for (auto p : page.mem)
-				destroy(p);
-		else  throw runtime_error("unmake: unknown type: " + page.type);
-		page.mem = {};
+		children(page, [&](int32_t p) { destroy(p); });
+		page.mem = {},  page.str = {};
 	}
 	void unmake_default(int32_t ptr) {
 		unmake(ptr);
 		int32_t p = make(heap.at(ptr).type);  // new default object
 		heap.at(ptr).mem = heap.at(p).mem;  // copy default values
-		heap.erase(p);  // remove old object
+		heap.at(ptr).str = heap.at(p).str;
+		heap.free(p);  // remove old object
 	}
 
 
@@ -193,50 +237,72 @@ struct Runtime {
 // --- Main runtime ---
 
 	int32_t run() {
+		if (profile)  prof.start(prog);
+		if (census)   cen.start(heap, funcindex("main"));
 		init();
 		// TODO: internal call
-		return call({ "main" });
+		Prog::Call ca = { "main" };
+		if ((ca.func = funcindex("main")) == -1)  throw runtime_error("missing function: main");
+		int32_t rval = call(ca);
+		if (profile)  prof.stop();
+		return rval;
 	}
-	void init() {
-		for (auto& t : prog.types)    init_type(t);
-		for (auto& d : prog.globals)  init_dim(d);
+	void reset() {
+		vstack.reserve(STACK_MAX);
+		globals.assign(prog.globals.size(), 0);
+		typeids.clear();
+		for (size_t i = 0; i < prog.types.size(); i++)
+			typeids.emplace(prog.types[i].name, i);
 	}
-	void init_type(const Prog::Type& t) {
-		for (size_t i = 0; i < t.members.size(); i++)
-			consts["USRTYPE_" + t.name + "_" + t.members[i].name] = i;
+	void init() {
+		reset();
+		for (size_t i = 0; i < prog.globals.size(); i++)
+			init_dim(prog.globals[i], globals[i]);
 	}
-	void init_dim(const Prog::Dim& d) {
-		auto& cframe = fstack.size() ? fstack.back() : globals;
-		cframe[d.name] = { d.type, 0 };
+	void init_dim(const Prog::Dim& d, int32_t& slot) {
+		slot = 0;
 		if (d.expr > -1 && d.type == "string")
 			expr(d.expr),
-			cframe[d.name].v = make_str( spop() );
+			slot = spop_new();
+		else if (d.expr > -1 && prog.exprs.at(d.expr).temp())
+			slot = expr(d.expr);  // a call's result is moved in
 		else if (d.expr > -1)
-			cframe[d.name].v = clone2( d.type, expr(d.expr) );
+			slot = clone2( d.type, expr(d.expr) );
 		else
-			cframe[d.name].v = make(d.type);
+			slot = make(d.type);
 	}
 
 
-	// run block
-	void block(pos_t bptr) {
+	// run block. the loop is built twice, so that it only pays for the profiler when profiling
+	Ctrl block(pos_t bptr) {
+		return profile ? block_run<1>(bptr) : block_run<0>(bptr);
+	}
+	template <int PROFILE>
+	Ctrl block_run(pos_t bptr) {
 		const Prog::Block& bl = prog.blocks.at(bptr);
-		for (auto& st : bl.statements)
+		Ctrl ctrl = CTRL_NONE;
+		for (auto& st : bl.statements) {
+			if (PROFILE)  prof.line(st.dsym);
+			switch (st.type) {
 			// I/O
-			if      (st.type == "print")        r_print(st.loc);
-			else if (st.type == "input")        r_input(st.loc);
+			case Stmt::print:      r_print(st.loc);  break;
+			case Stmt::input:      r_input(st.loc);  break;
 			// control blocks
-			else if (st.type == "if")           r_if(st.loc);
-			else if (st.type == "while")        r_while(st.loc);
-			else if (st.type == "for")          r_for(st.loc);
+			case Stmt::if_:        ctrl = r_if(st.loc);  break;
+			case Stmt::while_:     ctrl = r_while(st.loc);  break;
+			case Stmt::for_:       ctrl = r_for(st.loc);  break;
 			// control
-			else if (st.type == "return")       throw ctrl_return( st.loc > -1 ? expr(st.loc) : 0 );  // return (rval: expr OR default(0))
-			else if (st.type == "break")        throw ctrl_break(st.loc);     // break loop (arg: break-level)
-			else if (st.type == "continue")     throw ctrl_continue(st.loc);  // continue loop (arg: break-level)
+			case Stmt::return_:    ctrl_val = st.loc > -1 ? r_return(st.loc) : 0;  return CTRL_RETURN;  // return (rval: expr OR default(0))
+			case Stmt::break_:     ctrl_val = st.loc;  return CTRL_BREAK;     // break loop (arg: break-level)
+			case Stmt::continue_:  ctrl_val = st.loc;  return CTRL_CONTINUE;  // continue loop (arg: break-level)
 			// expressions
-			else if (st.type == "let")          let(st.loc);
-			else if (st.type == "call")         call(st.loc);
-			else    throw runtime_error("unknown statement: " + st.type);
+			case Stmt::let:        let(st.loc);  break;
+			case Stmt::call:       r_call(st.loc);  break;
+			default:  throw runtime_error(string("unknown statement: ") + stmtname(st.type));
+			}
+			if (ctrl)  return ctrl;  // unwind out of nested control block
+		}
+		return CTRL_NONE;
 	}
 
 
@@ -244,54 +310,91 @@ struct Runtime {
 	void r_print(pos_t ptr) {
 		const Prog::Print& pr = prog.prints.at(ptr);
 		for (auto& in : pr.instr)
-			if      (in.cmd == "literal")   printf("%s", prog.literals.at(in.iarg).c_str() );
-			else if (in.cmd == "expr")      printf("%d", expr(in.iarg) );
-			else if (in.cmd == "expr_str")  expr(in.iarg),  printf("%s", spop().c_str() );
-			else    throw runtime_error("unknown print: " + in.cmd);
+			switch (in.cmd) {
+			case Cmd::literal:   sprint( prog.literals.at(in.iarg) );  break;
+			case Cmd::expr:      printf("%d", expr(in.iarg) );  break;
+			case Cmd::expr_str:  expr(in.iarg),  sprint( spop() );  break;
+			default:  throw runtime_error(string("unknown print: ") + cmdname(in.cmd));
+			}
 		printf("\n");
 	}
 	void r_input(pos_t ptr) {
-		const Prog::Input& in = prog.inputs.at(ptr);
-		printf("%s", in.prompt.c_str() );
+		r_input_to( ptr, varpath(prog.inputs.at(ptr).varpath, 1).get() );
+	}
+	void r_input_to(pos_t ptr, int32_t dptr) {
+		printf("%s", prog.inputs.at(ptr).prompt.c_str() );
 		string s;
+		if (trace)  tracer.begin(Tracer::INPUT, ptr);
 		getline(cin, s);
-		clonestr( s, varpath(in.varpath) );
+		if (trace)  tracer.end();
+		clonestr( s, dptr );
 	}
-	void r_if(pos_t ptr) {
+	Ctrl r_if(pos_t ptr) {
 		const auto& ip = prog.ifs.at(ptr);
 		for (auto& cond : ip.conds)
 			// run block on empty OR truthy condition
-			if (cond.expr == -1 || expr(cond.expr)) {
-				block(cond.block);
-				break;
-			}
+			if (cond.expr == -1 || expr(cond.expr))
+				return block(cond.block);
+		return CTRL_NONE;
 	}
-	void r_while(pos_t ptr) {
+	Ctrl r_while(pos_t ptr) {
 		const auto& wh = prog.whiles.at(ptr);
 		while ( expr(wh.expr) )
-			try                        { block(wh.block); }
-			catch (ctrl_continue& con) { if (--con.val > 0) throw con;  continue; }
-			catch (ctrl_break&    brk) { if (--brk.val > 0) throw brk;  break; }
+			switch (block(wh.block)) {
+			case CTRL_NONE:      break;
+			case CTRL_RETURN:    return CTRL_RETURN;
+			case CTRL_CONTINUE:  if (--ctrl_val > 0)  return CTRL_CONTINUE;  break;
+			case CTRL_BREAK:     if (--ctrl_val > 0)  return CTRL_BREAK;     return CTRL_NONE;
+			}
+		return CTRL_NONE;
 	}
-	void r_for(pos_t ptr) {
+	Ctrl r_for(pos_t ptr) {
 		const auto& fo = prog.fors.at(ptr);
-		varpath(fo.varpath) = expr(fo.start_expr);
+		int32_t start = expr(fo.start_expr);
+		varpath(fo.varpath, 1).set(start);
 		while (true) {
-			if      (fo.step >= 0 && varpath(fo.varpath) > expr(fo.end_expr))  break;  // forward loop
-			else if (fo.step <  0 && varpath(fo.varpath) < expr(fo.end_expr))  break;  // reverse loop
-			try                        { block(fo.block); }
-			catch (ctrl_continue& con) { if (--con.val > 0) throw con; }
-			catch (ctrl_break&    brk) { if (--brk.val > 0) throw brk;  break; }
-			varpath(fo.varpath) += fo.step;  // step
+			if      (fo.step >= 0 && varpath(fo.varpath).get() > expr(fo.end_expr))  break;  // forward loop
+			else if (fo.step <  0 && varpath(fo.varpath).get() < expr(fo.end_expr))  break;  // reverse loop
+			switch (block(fo.block)) {
+			case CTRL_NONE:      break;
+			case CTRL_RETURN:    return CTRL_RETURN;
+			case CTRL_CONTINUE:  if (--ctrl_val > 0)  return CTRL_CONTINUE;  break;
+			case CTRL_BREAK:     if (--ctrl_val > 0)  return CTRL_BREAK;     return CTRL_NONE;
+			}
+			Ref r = varpath(fo.varpath, 1);
+			r.set(r.get() + fo.step);  // step
 		}
+		return CTRL_NONE;
 	}
 	void let(pos_t ptr) {
 		const auto& l = prog.lets.at(ptr);
-		int32_t& vp = varpath(l.varpath);  // TODO: execution order could cause bugs with arrays potentially
-		int32_t  ex = expr(l.expr);
-		if      (l.type == "int")     vp = ex;
-		else if (l.type == "string")  clonestr(spop(), vp);
-		else if (vp != ex)            cloneto(ex, vp);
+		if (l.append) {
+			expr(l.expr);
+			appendstr( spop(), varpath(l.varpath, 1).get() );
+			return;
+		}
+		pos_t   ix = varpath_index(l.varpath);  // the path's indexes first,
+		int32_t ex = expr(l.expr);              // then the value, which may share or move the path's pages,
+		Ref     vp = varpath(l.varpath, 1, ix);  // so the path is walked last
+		if      (l.type == "int")                vp.set(ex);
+		else if (l.type == "string")             spop_to(vp.get());
+		else if (prog.exprs.at(l.expr).temp())  moveto(ex, vp.get());  // a call's result
+		else if (vp.get() != ex)                 cloneto(ex, vp.get());
+		vals.resize(ix);  // drop the indexes
+	}
+	// return value. objects are shared out of the frame, unless they are a call's result already.
+	// strings stay on vals, for call() to take out of the frame
+	int32_t r_return(pos_t eptr) {
+		const auto& ex = prog.exprs.at(eptr);
+		int32_t     t  = expr(eptr);
+		return ex.type == "int" || ex.type == "string" || ex.temp() ? t : clone(t);
+	}
+	// call statement: the result is dropped
+	void r_call(pos_t ptr) {
+		const auto& ca = prog.calls.at(ptr);
+		int32_t     t  = call(ca);
+		if      (ca.type == "string")  spop();
+		else if (ca.type != "int")     destroy(t);
 	}
 
 
@@ -299,148 +402,267 @@ struct Runtime {
 	int32_t call(pos_t ptr) { return call(prog.calls.at(ptr)); }
 	int32_t call(const Prog::Call& ca) {
 		// if not user function, run internal function
-		if (funcindex(ca.fname) == -1)
+		if (ca.func == -1)
 			return call_system(ca);
 		// calculate arguments in current frame context
-		auto& fn = getfunc(ca.fname);                                   // get user function def
-		StackFrame newframe;                                            // new stack frame
+		auto& fn = prog.functions[ca.func];                             // get user function def
+		pos_t base = vstack.size();                                     // new frame starts at stack top
+		vector<int32_t> temps;                                          // call results passed by reference, dropped after
+		size_t          npins = pins.size();                            // pages pinned by the arguments, unpinned after
 		assert( fn.args.size() == ca.args.size() );                     // basic arguments error
 		for (pos_t i = 0; i < fn.args.size(); i++) {
 			assert( fn.args[i].type == ca.args[i].type );               // basic argument error
-			int32_t ex = expr(ca.args[i].expr);                         // run argument expression
-			if (fn.args[i].type == "string")  ex = make_str(spop());    // new string by value
-			newframe[fn.args[i].name] = { fn.args[i].type, ex };        // push to stack
+			int32_t ex = expr(ca.args[i].expr, 2);                      // run argument expression (objects by reference, pinned)
+			if      (fn.args[i].type == "string")  ex = spop_new();     // new string by value
+			else if (prog.exprs.at(ca.args[i].expr).temp())  temps.push_back(ex);
+			if (base + i >= STACK_MAX)  throw runtime_error("stack overflow");
+			vstack.push_back(ex);                                       // push to stack
 		}
+		materialize();                                                  // the call may change strings the caller is viewing
+		if (profile)  prof.enter(ca.func, fn.dsym);
+		if (trace)    tracer.begin(Tracer::FUNC, ca.func);
+		if (census)   cen.enter(ca.func, ca.dsym);
 		// push new frame and calculate locals
-		fstack.push_back(newframe);  
-		for (auto& d : fn.locals)
-			// ftop()[d.name] = { d.type, make(d.type) };
-			init_dim(d);
-		// run main block
-		int32_t rval = 0;
-		try { block(fn.block); }
-		catch (ctrl_return& r) { rval = r.val; }
+		frame_push(base, fn.args.size() + fn.locals.size());
+		for (size_t i = 0; i < fn.locals.size(); i++)
+			init_dim(fn.locals[i], get(fn.args.size() + i));
+		// run main block. a string result is left on vals, and must not view the frame's pages
+		Ctrl    ctrl = block(fn.block);
+		int32_t rval = ctrl == CTRL_RETURN ? ctrl_val : 0;
+		if      (fn.type == "int")     ;
+		else if (fn.type == "string")  ctrl == CTRL_RETURN ? sown(fn) : spush_tmp("");
+		else if (ctrl != CTRL_RETURN)  rval = make(fn.type);  // default object
 		// cleanup
-		for (auto& d : fn.locals)
-			if (d.type != "int")  destroy( get(d.name) );      // destroy local variables only in frame
-		for (auto& d : fn.args)
-			if (d.type == "string")  destroy( get(d.name) );   // destroy argument strings (pass-by-value)
-		fstack.pop_back();                                     // destroy stack frame
+		if (profile)  prof.unwind(fn.dsym);
+		frame_leave(fn);
+		for (auto t : temps)  destroy(t);
+		unpin(npins);
+		if (profile)  prof.leave();
+		if (trace)    tracer.end();
+		if (census)   cen.leave();
 		return rval;
 	}
+	void frame_leave(const Prog::Function& fn) {
+		for (size_t i = 0; i < fn.locals.size(); i++)
+			if (fn.locals[i].type != "int")  destroy( get(fn.args.size() + i) );  // destroy local variables only in frame
+		for (size_t i = 0; i < fn.args.size(); i++)
+			if (fn.args[i].type == "string")  destroy( get(i) );                  // destroy argument strings (pass-by-value)
+		frame_pop();                                                              // destroy stack frame
+	}
+	// traced, except for len: it is O(1), and in loop conditions it would flood the trace
 	int32_t call_system(const Prog::Call& ca) {
+		if (!trace || ca.sys == Sys::len)  return call_sys(ca);
+		tracer.begin(Tracer::SYS, (int32_t)ca.sys);
+		int32_t rval = call_sys(ca);
+		tracer.end();
+		return rval;
+	}
+	int32_t call_sys(const Prog::Call& ca) {
+		switch (ca.sys) {
 		// push array
-		if (ca.fname == "push") {
-			int32_t t  = 0,  arrptr = expr(ca.args.at(0).expr),  val = expr(ca.args.at(1).expr);
+		case Sys::push: {
 			auto&   av = ca.args.at(1);
-			if      (av.type == "int")     heap.at(arrptr).mem.push_back(val);
-			else if (av.type == "string")  t = make_str(spop()),  heap.at(arrptr).mem.push_back(t);
-			else    t = clone(val),  heap.at(arrptr).mem.push_back(t);
+			auto&   ar = prog.exprs.at(ca.args.at(0).expr).instr;
+			int     vp = ar.size() == 1 && ar[0].cmd == Cmd::varpath_ptr;
+			pos_t   ix = vp ? varpath_index(ar[0].iarg) : vals.size();  // array first, as in let
+			int32_t t  = 0,  arrptr = vp ? 0 : expr(ca.args.at(0).expr, 1),  val = expr(av.expr);
+			if (vp)  arrptr = varpath(ar[0].iarg, 1, ix).get();
+			if      (av.type == "int")                memwrite(arrptr).mem.push_back(val);
+			else if (av.type == "string")             t = spop_new(),  memwrite(arrptr).mem.push_back(t);
+			else if (prog.exprs.at(av.expr).temp())  memwrite(arrptr).mem.push_back(val);  // a call's result is moved in
+			else    t = clone(val),  memwrite(arrptr).mem.push_back(t);
+			vals.resize(ix);
 			return 0;
 		}
 		// pop array
-		else if (ca.fname == "pop") {
-			int32_t arrptr = expr(ca.args.at(0).expr);
-			auto&   mem    = heap.at(arrptr).mem;
+		case Sys::pop: {
+			int32_t arrptr = expr(ca.args.at(0).expr, 1);
+			materialize();
+			auto&   mem    = memwrite(arrptr).mem;
 			int32_t val    = mem.at(mem.size() - 1);  // save the value we're popping
 			if (ca.args.at(0).type != "int[]")  destroy(val);
 			mem.pop_back();
 			return val;  // return it
 		}
 		// array length
-		else if (ca.fname == "len") {
-			int32_t arrptr = expr(ca.args.at(0).expr);
-			if (ca.args.at(0).type == "string")  return spop().size();
-			else  return heap.at(arrptr).mem.size();
+		case Sys::len: {
+			auto&   av     = ca.args.at(0);
+			int32_t arrptr = expr(av.expr);
+			if (av.type == "string")  return spop().size();
+			int32_t n = heap.at(arrptr).mem.size();
+			if (prog.exprs.at(av.expr).temp())  destroy(arrptr);
+			return n;
 		}
 		// reset memory to default
-		else if (ca.fname == "default") {
-			int32_t ptr = expr(ca.args.at(0).expr);
+		case Sys::default_: {
+			int32_t ptr = expr(ca.args.at(0).expr, 1);
+			materialize();
 			unmake_default(ptr);
 			return 0;
 		}
-		else  throw runtime_error("unknown function: " + ca.fname);
+		default:  throw runtime_error("unknown function: " + ca.fname);
+		}
 	}
 
 
-	// variable path parsing
-	int32_t& varpath(pos_t vptr) {
+	// variable path parsing. write: the pages along the path are written through, so shared ones are copied.
+	// write 2: they are also pinned, for a by-reference argument. ix: indexes from varpath_index, on vals
+	Ref varpath(pos_t vptr, int write=0, pos_t ix=-1) {
 		const Prog::VarPath& vp = prog.varpaths.at(vptr);
 		int32_t* ptr = NULL;
-		for (auto& in : vp.instr) {
-			if      (in.cmd == "get")          ptr = &get(in.sarg);
-			else if (in.cmd == "get_global")   ptr = &get_global(in.sarg);
-			else if (ptr == NULL)              goto err;
-			else if (in.cmd == "memget_expr")  ptr = &memget(*ptr, expr(in.iarg) );
-			else if (in.cmd == "memget_prop")  ptr = &memget(*ptr, getnum(in.sarg) );
-			else    throw runtime_error("unknown varpath: " + in.cmd);
-		}
+		int32_t  t   = 0;
+		for (auto& in : vp.instr)
+			switch (in.cmd) {
+			case Cmd::get:          ptr = &get(in.iarg);  break;
+			case Cmd::get_global:   ptr = &get_global(in.iarg);  break;
+			case Cmd::memget_expr:  if (ptr == NULL)  goto err;  if (write == 2)  pin(*ptr);
+			                        t = ix > -1 ? vals[ix++].v : expr(in.iarg),  ptr = write ? &memwrite(*ptr).mem.at(t) : &memget(*ptr, t);  break;
+			case Cmd::memget_prop:  if (ptr == NULL)  goto err;  if (write == 2)  pin(*ptr);
+			                        ptr = write ? &memwrite(*ptr).mem.at(in.iarg) : &memget(*ptr, in.iarg);  break;
+			case Cmd::memget_chr:   if (ptr == NULL)  goto err;  t = ix > -1 ? vals[ix++].v : expr(in.iarg);  return { NULL, write ? &memwrite(*ptr).str.at(t) : &memget_chr(*ptr, t) };  // always last in path
+			default:  throw runtime_error(string("unknown varpath: ") + cmdname(in.cmd));
+			}
 		if (ptr == NULL)  goto err;
-		return *ptr;
+		return { ptr, NULL };
 		err:  throw out_of_range("memget ptr is null");
 	}
-	string varpath_str(pos_t vptr) {
-		const auto& mem = heap.at( varpath(vptr) ).mem;
-		return string(mem.begin(), mem.end());
+	// a write path's index expressions, run in path order onto vals before the written value. returns where they start
+	pos_t varpath_index(pos_t vptr) {
+		pos_t ix = vals.size();
+		for (auto& in : prog.varpaths.at(vptr).instr)
+			if (in.cmd == Cmd::memget_expr || in.cmd == Cmd::memget_chr)  ipush( expr(in.iarg) );
+		return ix;
+	}
+	int32_t varpath_str(pos_t vptr) {
+		return varpath(vptr).get();
 	}
 
 
-	// expression parsing
-	int32_t expr(pos_t eptr) {
+	// expression parsing. write: object and array arguments are passed by reference, so the callee may write them (see varpath)
+	int32_t expr(pos_t eptr, int write=0) {
 		const Prog::Expr& ex = prog.exprs.at(eptr);
-		pos_t istack_start = istack.size(), sstack_start = sstack.size();  // remember stack pos, for sanity
+		pos_t start = vals.size();  // remember stack pos, for sanity
 		int32_t t = 0, u = 0;
-		string s, q;
+		string_view s, q;
 		for (auto& in : ex.instr)
+			switch (in.cmd) {
 			// integers
-			if      (in.cmd == "i")            ipush(in.iarg);
-			else if (in.cmd == "varpath")      ipush( varpath(in.iarg) );
-			else if (in.cmd == "add")          t = ipop(),  ipeek() += t;
-			else if (in.cmd == "sub")          t = ipop(),  ipeek() -= t;
-			else if (in.cmd == "mul")          t = ipop(),  ipeek() *= t;
-			else if (in.cmd == "div")          t = ipop(),  ipeek() /= t;
-			else if (in.cmd == "and")          t = ipop(),  ipeek()  = ipeek() && t;
-			else if (in.cmd == "or")           t = ipop(),  ipeek()  = ipeek() || t;
-			else if (in.cmd == "eq")           t = ipop(),  u = ipop(),  ipush(u == t);
-			else if (in.cmd == "neq")          t = ipop(),  u = ipop(),  ipush(u != t);
-			else if (in.cmd == "lt")           t = ipop(),  u = ipop(),  ipush(u <  t);
-			else if (in.cmd == "gt")           t = ipop(),  u = ipop(),  ipush(u >  t);
-			else if (in.cmd == "lte")          t = ipop(),  u = ipop(),  ipush(u <= t);
-			else if (in.cmd == "gte")          t = ipop(),  u = ipop(),  ipush(u >= t);
+			case Cmd::i:            ipush(in.iarg);  break;
+			case Cmd::varpath:      ipush( varpath(in.iarg).get() );  break;
+			case Cmd::add:          t = ipop(),  ipeek() += t;  break;
+			case Cmd::sub:          t = ipop(),  ipeek() -= t;  break;
+			case Cmd::mul:          t = ipop(),  ipeek() *= t;  break;
+			case Cmd::div:          t = ipop(),  ipeek() /= t;  break;
+			case Cmd::and_:         t = ipop(),  ipeek()  = ipeek() && t;  break;
+			case Cmd::or_:          t = ipop(),  ipeek()  = ipeek() || t;  break;
+			case Cmd::eq:           t = ipop(),  u = ipop(),  ipush(u == t);  break;
+			case Cmd::neq:          t = ipop(),  u = ipop(),  ipush(u != t);  break;
+			case Cmd::lt:           t = ipop(),  u = ipop(),  ipush(u <  t);  break;
+			case Cmd::gt:           t = ipop(),  u = ipop(),  ipush(u >  t);  break;
+			case Cmd::lte:          t = ipop(),  u = ipop(),  ipush(u <= t);  break;
+			case Cmd::gte:          t = ipop(),  u = ipop(),  ipush(u >= t);  break;
 			// strings
-			else if (in.cmd == "lit")          spush(in.iarg);
-			else if (in.cmd == "varpath_str")  spush(varpath_str(in.iarg));
-			else if (in.cmd == "strcat")       s = spop(),  speek() += s;
-			else if (in.cmd == "eq_str")       s = spop(),  q = spop(),  ipush(q == s);
-			else if (in.cmd == "neq_str")      s = spop(),  q = spop(),  ipush(q != s);
+			case Cmd::lit:          spush(in.iarg);  break;
+			case Cmd::varpath_str:  spush_ref(varpath_str(in.iarg));  break;
+			case Cmd::strcat:       strcat();  break;
+			case Cmd::eq_str:       s = spop(),  q = spop(),  ipush(q == s);  break;
+			case Cmd::neq_str:      s = spop(),  q = spop(),  ipush(q != s);  break;
 			// other
-			else if (in.cmd == "varpath_ptr")  ipush(varpath(in.iarg));
-			else if (in.cmd == "call")         ipush(call(in.iarg));
-			else    throw runtime_error("unknown expr: " + in.cmd);
+			case Cmd::varpath_ptr:  ipush( varpath(in.iarg, write).get() );  break;
+			case Cmd::call:         t = call(in.iarg);  if (prog.calls[in.iarg].type != "string")  ipush(t);  break;  // strings are left on vals
+			default:  throw runtime_error(string("unknown expr: ") + cmdname(in.cmd));
+			}
 		// sanity check
-		pos_t istack_end = istack.size() - istack_start, sstack_end = sstack.size() - sstack_start;
-		if (istack_end + sstack_end != 1) {
-			printf("WARNING: odd expression results  i %d  s %d\n", istack_end, sstack_end );
-			for (pos_t i = 0; i < istack.size(); i++)
-				printf("  %02di  %d\n", i, istack[i] );
-			for (pos_t i = 0; i < sstack.size(); i++)
-				printf("  %02ds  %s\n", i, sstack[i].c_str() );
+		if (vals.size() - start != 1) {
+			printf("WARNING: odd expression results  %d\n", (int)(vals.size() - start) );
+			for (pos_t i = 0; i < (pos_t)vals.size(); i++)
+				if    (vals[i].tag == Val::INT)  printf("  %02di  %d\n", i, vals[i].v );
+				else  printf("  %02ds  %s\n", i, string(sview(i)).c_str() );
 		}
 		// result
-		return istack.size() ? ipop() : 0;
+		return (pos_t)vals.size() > start && vals.back().tag == Val::INT ? ipop() : 0;  // string results stay on the stack
 	}
 	// string expr_str(pos_t ex) {
 	// 	expr(ex);
 	// 	return spop();
 	// }
 	// expression stack operations
-	int32_t& ipeek() { return istack.at(istack.size() - 1); }
-	int32_t  ipop () { auto t = istack.at(istack.size() - 1);  istack.pop_back();  return t; }
-	void     ipush(int32_t t) { istack.push_back(t); }
-	string&  speek() { return sstack.at(sstack.size() - 1); }
-	string   spop () { auto t = sstack.at(sstack.size() - 1);  sstack.pop_back();  return t; }
-	void     spush(const string& t) { sstack.push_back(t); }
-	void     spush(pos_t loc) { sstack.push_back( prog.literals.at(loc) ); }
+	int32_t& ipeek() { return vals.at(vals.size() - 1).v; }
+	int32_t  ipop () { auto t = vals.at(vals.size() - 1).v;  vals.pop_back();  return t; }
+	void     ipush(int32_t t) { vals.push_back({ Val::INT, t }); }
+	void     spush(pos_t loc) { vals.push_back({ Val::LIT, loc }); }
+	void     spush_ref(int32_t ptr) { vals.push_back({ Val::HEAP, ptr }),  nviews++; }
+	void     spush_tmp(string_view s) {
+		pos_t pos = vals.size();
+		if ((pos_t)tmps.size() <= pos)  tmps.resize(pos + 1);
+		tmps[pos] = s,  vals.push_back({ Val::TMP, 0 });
+	}
+	string_view sview(pos_t pos) const {
+		const Val& v = vals.at(pos);
+		switch (v.tag) {
+		case Val::LIT:   return prog.literals[v.v];
+		case Val::HEAP:  return memstr(v.v);
+		case Val::TMP:   return tmps[pos];
+		default:         throw runtime_error("expected string on expression stack");
+		}
+	}
+	// the view stays valid until the next string push or heap change
+	string_view spop() {
+		auto s = sview(vals.size() - 1);
+		if (vals.back().tag == Val::HEAP)  nviews--;
+		vals.pop_back();
+		return s;
+	}
+	// pop the top string into page dptr. a temporary hands over its buffer rather than being copied
+	void spop_to(int32_t dptr) {
+		if (vals.back().tag != Val::TMP)  return clonestr(spop(), dptr);
+		if (heap.shared(dptr))  heap.detach(dptr);
+		swap(heap.at(dptr).str, tmps[vals.size() - 1]);
+		vals.pop_back();
+	}
+	int32_t spop_new() {
+		int32_t ptr = memalloc("string", 0);
+		spop_to(ptr);
+		return ptr;
+	}
+	// a function's string result must outlive its frame. a view of one of the frame's own strings
+	// takes over its buffer, as the page goes with the frame; a view of any other page is copied
+	void sown(const Prog::Function& fn) {
+		pos_t pos = vals.size() - 1;
+		if (vals.at(pos).tag != Val::HEAP)  return;  // literals and temporaries don't depend on the frame
+		int32_t ptr = vals[pos].v,  own = 0;
+		for (size_t i = 0; i < fn.args.size(); i++)    own |= fn.args[i].type == "string" && get(i) == ptr;
+		for (size_t i = 0; i < fn.locals.size(); i++)  own |= fn.locals[i].type == "string" && get(fn.args.size() + i) == ptr;
+		if ((pos_t)tmps.size() <= pos)  tmps.resize(pos + 1);
+		if    (own && !heap.shared(ptr))  swap(tmps[pos], heap.at(ptr).str);
+		else  tmps[pos] = memstr(ptr);
+		vals[pos].tag = Val::TMP,  nviews--;
+	}
+	// append into the left operand's own buffer, copying it out of its view first if needed
+	void strcat() {
+		auto  s   = spop();
+		pos_t pos = vals.size() - 1;
+		Val&  v   = vals.at(pos);
+		if (v.tag != Val::TMP) {
+			if ((pos_t)tmps.size() <= pos)  tmps.resize(pos + 1);  // safe: s is not a TMP above pos
+			tmps[pos] = sview(pos);
+			if (v.tag == Val::HEAP)  nviews--;
+			v.tag = Val::TMP;
+		}
+		tmps[pos] += s;
+	}
+	// copy heap views to their own buffers, before running code that may change the heap
+	void materialize() {
+		if (nviews == 0)  return;
+		if (tmps.size() < vals.size())  tmps.resize(vals.size());
+		for (pos_t i = 0; i < (pos_t)vals.size(); i++)
+			if (vals[i].tag == Val::HEAP)
+				tmps[i] = memstr(vals[i].v),  vals[i].tag = Val::TMP;
+		nviews = 0;
+	}
+	void sprint(string_view s) {
+		printf("%.*s", (int)s.size(), s.data() );
+	}
 
 
 
@@ -449,12 +671,10 @@ struct Runtime {
 	void show() {
 		// printf("  heap:  %d\n", heap.size() );
 		// printf("  stack:  i.%d  s.%d\n", istack.size(), sstack.size() );
-		printf("  heap %d | istack %d | sstack %d\n", (int)heap.size(), (int)istack.size(), (int)sstack.size() );
-		printf("  consts:\n");
-		for (auto& c : consts)
-			printf("    %s  %d\n", c.first.c_str(), c.second );
+		printf("  heap %d | vals %d | vstack %d\n", (int)heap.size(), (int)vals.size(), (int)vstack.size() );
+		heap.show();
 		printf("  globals:\n");
-		for (auto& g : globals)
-			printf("    %-10s  %d\n", g.first.c_str(), g.second.v );
+		for (size_t i = 0; i < globals.size(); i++)
+			printf("    %-10s  %d\n", prog.globals[i].name.c_str(), globals[i] );
 	}
 };
\ No newline at end of file
@@ -1,7 +1,3 @@
-type stringp
-	dim string val
-end type
-
 type room_t
 	dim string name
 	dim string description
@@ -35,7 +31,6 @@ end function
 function mainloop()
 	dim l, do_look = 1
 	dim string inp
-	dim stringp estr
 	dim string[] cmd
 
 	while 1
@@ -45,8 +40,7 @@ function mainloop()
 			if croom == 6  # final room
 				return 1
 			end if
-			getexits(estr)
-			print "exits:", estr.val
+			print "exits:", getexits()
 			let do_look = 0
 		end if
 		# get input
@@ -87,8 +81,9 @@ function mainloop()
 end function
 
 
-function getexits(stringp ptr)
+function string getexits()
 	dim i
+	dim string s
 	dim string[] exits
 	dim room_t r = rooms[croom]
 	# find exits
@@ -105,13 +100,13 @@ function getexits(stringp ptr)
 		push(exits, "w")
 	end if
 	# join
-	let ptr.val = ""
 	for i = 0 to len(exits) - 1
-		if len(ptr.val) > 0
-			ptr.val = ptr.val + ", "
+		if len(s) > 0
+			s = s + ", "
 		end if
-		ptr.val = ptr.val + exits[i]
+		s = s + exits[i]
 	end for
+	return s
 end function
 
 
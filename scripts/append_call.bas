@@ -0,0 +1,22 @@
+# regression: s = s + a[f()] must not become an append when f() changes s.
+# expected output:  old:y  and  xy
+
+dim string s
+
+
+function main()
+	dim string[] a
+	push(a, "x")
+	push(a, "y")
+	s = "old:"
+	s = s + a[f()]
+	print s
+	s = ""
+	s = s + a[0] + a[len(a) - 1]
+	print s
+end function
+
+function int f()
+	s = "new:"
+	return 1
+end function
@@ -0,0 +1,22 @@
+# benchmark: build a 1 MB string one character at a time with s = s + c,
+# and a property string with p.val = p.val + ", ", as in advent2.bas.
+
+type Pair
+	dim string key
+	dim string val
+end type
+
+
+function main()
+	dim i, n = 1048576
+	dim string s, c = "x"
+	dim Pair p
+	for i = 1 to n
+		s = s + c
+	end for
+	for i = 1 to 10000
+		p.val = p.val + "ab" + c + ", "
+	end for
+	s = s + c + "!"
+	print "bench_append", len(s), len(p.val), s[len(s) - 1]
+end function
@@ -0,0 +1,35 @@
+# benchmark: string comparison chains, modelled on the command dispatch in advent2.bas.
+
+function dispatch(string[] cmd)
+	if cmd[0] == "q" || cmd[0] == "quit"
+		return 1
+	else if cmd[0] == "l" || cmd[0] == "look"
+		return 2
+	else if cmd[0] == "n" || cmd[0] == "north"
+		return 3
+	else if cmd[0] == "s" || cmd[0] == "south"
+		return 4
+	else if cmd[0] == "e" || cmd[0] == "east"
+		return 5
+	else if cmd[0] == "w" || cmd[0] == "west"
+		return 6
+	end if
+	return 0
+end function
+
+
+function main()
+	dim i, acc
+	dim string[] cmd
+	push(cmd, "look")
+	push(cmd, "around")
+	for i = 1 to 50000
+		acc = acc + dispatch(cmd)
+		cmd[0] = "west"
+		acc = acc + dispatch(cmd)
+		cmd[0] = "examine-the-strange-markings"
+		acc = acc + dispatch(cmd)
+		cmd[0] = "look"
+	end for
+	print "bench_compare", acc
+end function
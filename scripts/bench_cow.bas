@@ -0,0 +1,61 @@
+# benchmark: copying large arrays of user types. copies share pages until written to.
+
+type item_t
+	dim string name
+	dim weight
+end type
+
+type room_t
+	dim string name
+	dim string description
+	dim x
+	dim y
+	dim item_t[] items
+end type
+
+dim room_t[] rooms
+dim room_t[] saved
+
+
+function buildrooms()
+	dim i, j
+	dim room_t r
+	dim item_t it
+	for i = 0 to 1999
+		default(r)
+		r.name = "room"
+		r.description = "a long and winding description of the room"
+		r.x = i
+		r.y = i * 2
+		for j = 0 to 3
+			it.name = "item"
+			it.weight = j
+			push(r.items, it)
+		end for
+		push(rooms, r)
+	end for
+end function
+
+
+# by value: a local copy of one room, read only
+function weight(int i)
+	dim w, j
+	dim room_t r = rooms[i]
+	for j = 0 to len(r.items) - 1
+		w = w + r.items[j].weight
+	end for
+	return w + r.x
+end function
+
+
+function main()
+	dim i, acc
+	buildrooms()
+	for i = 1 to 500
+		saved = rooms                         # snapshot the whole array
+		rooms[i].x = rooms[i].x + 1           # then change one room of it
+		rooms[i].items[0].weight = i
+		acc = acc + weight(i) + saved[i].x
+	end for
+	print "bench_cow", acc, rooms[10].x, saved[10].x, rooms[10].items[0].weight, saved[10].items[0].weight
+end function
@@ -0,0 +1,43 @@
+# benchmark: tight loops that use continue / break, and short function calls.
+
+function odd(int n)
+	return n - n / 2 * 2
+end function
+
+
+function clamp(int n, int hi)
+	if n > hi
+		return hi
+	end if
+	return n
+end function
+
+
+function main()
+	dim i, j, acc
+	for i = 1 to 100000
+		if odd(i)
+			continue
+		end if
+		acc = acc + clamp(i, 5000)
+		for j = 1 to 5
+			if j == 2
+				continue
+			else if j == 4
+				continue 2
+			end if
+			acc = acc + 1
+		end for
+	end for
+	i = 0
+	while 1
+		i = i + 1
+		if i > 100000
+			break
+		else if odd(i)
+			continue
+		end if
+		acc = acc - 1
+	end while
+	print "bench_ctrl", acc
+end function
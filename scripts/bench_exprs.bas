@@ -0,0 +1,326 @@
+# benchmark: a hot loop placed after a large amount of program text.
+# the loop's expressions sit at the end of every node table, so lookup cost
+# that grows with table position shows up directly in the run time.
+
+dim x
+
+function ballast()
+	dim a, b, c
+	a = b + 0 * c - (a + 1) / 2
+	a = b + 1 * c - (a + 2) / 2
+	a = b + 2 * c - (a + 3) / 2
+	a = b + 3 * c - (a + 4) / 2
+	a = b + 4 * c - (a + 5) / 2
+	a = b + 5 * c - (a + 6) / 2
+	a = b + 6 * c - (a + 7) / 2
+	a = b + 7 * c - (a + 8) / 2
+	a = b + 8 * c - (a + 9) / 2
+	a = b + 9 * c - (a + 10) / 2
+	a = b + 10 * c - (a + 11) / 2
+	a = b + 11 * c - (a + 12) / 2
+	a = b + 12 * c - (a + 13) / 2
+	a = b + 13 * c - (a + 14) / 2
+	a = b + 14 * c - (a + 15) / 2
+	a = b + 15 * c - (a + 16) / 2
+	a = b + 16 * c - (a + 17) / 2
+	a = b + 17 * c - (a + 18) / 2
+	a = b + 18 * c - (a + 19) / 2
+	a = b + 19 * c - (a + 20) / 2
+	a = b + 20 * c - (a + 21) / 2
+	a = b + 21 * c - (a + 22) / 2
+	a = b + 22 * c - (a + 23) / 2
+	a = b + 23 * c - (a + 24) / 2
+	a = b + 24 * c - (a + 25) / 2
+	a = b + 25 * c - (a + 26) / 2
+	a = b + 26 * c - (a + 27) / 2
+	a = b + 27 * c - (a + 28) / 2
+	a = b + 28 * c - (a + 29) / 2
+	a = b + 29 * c - (a + 30) / 2
+	a = b + 30 * c - (a + 31) / 2
+	a = b + 31 * c - (a + 32) / 2
+	a = b + 32 * c - (a + 33) / 2
+	a = b + 33 * c - (a + 34) / 2
+	a = b + 34 * c - (a + 35) / 2
+	a = b + 35 * c - (a + 36) / 2
+	a = b + 36 * c - (a + 37) / 2
+	a = b + 37 * c - (a + 38) / 2
+	a = b + 38 * c - (a + 39) / 2
+	a = b + 39 * c - (a + 40) / 2
+	a = b + 40 * c - (a + 41) / 2
+	a = b + 41 * c - (a + 42) / 2
+	a = b + 42 * c - (a + 43) / 2
+	a = b + 43 * c - (a + 44) / 2
+	a = b + 44 * c - (a + 45) / 2
+	a = b + 45 * c - (a + 46) / 2
+	a = b + 46 * c - (a + 47) / 2
+	a = b + 47 * c - (a + 48) / 2
+	a = b + 48 * c - (a + 49) / 2
+	a = b + 49 * c - (a + 50) / 2
+	a = b + 50 * c - (a + 51) / 2
+	a = b + 51 * c - (a + 52) / 2
+	a = b + 52 * c - (a + 53) / 2
+	a = b + 53 * c - (a + 54) / 2
+	a = b + 54 * c - (a + 55) / 2
+	a = b + 55 * c - (a + 56) / 2
+	a = b + 56 * c - (a + 57) / 2
+	a = b + 57 * c - (a + 58) / 2
+	a = b + 58 * c - (a + 59) / 2
+	a = b + 59 * c - (a + 60) / 2
+	a = b + 60 * c - (a + 61) / 2
+	a = b + 61 * c - (a + 62) / 2
+	a = b + 62 * c - (a + 63) / 2
+	a = b + 63 * c - (a + 64) / 2
+	a = b + 64 * c - (a + 65) / 2
+	a = b + 65 * c - (a + 66) / 2
+	a = b + 66 * c - (a + 67) / 2
+	a = b + 67 * c - (a + 68) / 2
+	a = b + 68 * c - (a + 69) / 2
+	a = b + 69 * c - (a + 70) / 2
+	a = b + 70 * c - (a + 71) / 2
+	a = b + 71 * c - (a + 72) / 2
+	a = b + 72 * c - (a + 73) / 2
+	a = b + 73 * c - (a + 74) / 2
+	a = b + 74 * c - (a + 75) / 2
+	a = b + 75 * c - (a + 76) / 2
+	a = b + 76 * c - (a + 77) / 2
+	a = b + 77 * c - (a + 78) / 2
+	a = b + 78 * c - (a + 79) / 2
+	a = b + 79 * c - (a + 80) / 2
+	a = b + 80 * c - (a + 81) / 2
+	a = b + 81 * c - (a + 82) / 2
+	a = b + 82 * c - (a + 83) / 2
+	a = b + 83 * c - (a + 84) / 2
+	a = b + 84 * c - (a + 85) / 2
+	a = b + 85 * c - (a + 86) / 2
+	a = b + 86 * c - (a + 87) / 2
+	a = b + 87 * c - (a + 88) / 2
+	a = b + 88 * c - (a + 89) / 2
+	a = b + 89 * c - (a + 90) / 2
+	a = b + 90 * c - (a + 91) / 2
+	a = b + 91 * c - (a + 92) / 2
+	a = b + 92 * c - (a + 93) / 2
+	a = b + 93 * c - (a + 94) / 2
+	a = b + 94 * c - (a + 95) / 2
+	a = b + 95 * c - (a + 96) / 2
+	a = b + 96 * c - (a + 97) / 2
+	a = b + 97 * c - (a + 98) / 2
+	a = b + 98 * c - (a + 99) / 2
+	a = b + 99 * c - (a + 100) / 2
+	a = b + 100 * c - (a + 101) / 2
+	a = b + 101 * c - (a + 102) / 2
+	a = b + 102 * c - (a + 103) / 2
+	a = b + 103 * c - (a + 104) / 2
+	a = b + 104 * c - (a + 105) / 2
+	a = b + 105 * c - (a + 106) / 2
+	a = b + 106 * c - (a + 107) / 2
+	a = b + 107 * c - (a + 108) / 2
+	a = b + 108 * c - (a + 109) / 2
+	a = b + 109 * c - (a + 110) / 2
+	a = b + 110 * c - (a + 111) / 2
+	a = b + 111 * c - (a + 112) / 2
+	a = b + 112 * c - (a + 113) / 2
+	a = b + 113 * c - (a + 114) / 2
+	a = b + 114 * c - (a + 115) / 2
+	a = b + 115 * c - (a + 116) / 2
+	a = b + 116 * c - (a + 117) / 2
+	a = b + 117 * c - (a + 118) / 2
+	a = b + 118 * c - (a + 119) / 2
+	a = b + 119 * c - (a + 120) / 2
+	a = b + 120 * c - (a + 121) / 2
+	a = b + 121 * c - (a + 122) / 2
+	a = b + 122 * c - (a + 123) / 2
+	a = b + 123 * c - (a + 124) / 2
+	a = b + 124 * c - (a + 125) / 2
+	a = b + 125 * c - (a + 126) / 2
+	a = b + 126 * c - (a + 127) / 2
+	a = b + 127 * c - (a + 128) / 2
+	a = b + 128 * c - (a + 129) / 2
+	a = b + 129 * c - (a + 130) / 2
+	a = b + 130 * c - (a + 131) / 2
+	a = b + 131 * c - (a + 132) / 2
+	a = b + 132 * c - (a + 133) / 2
+	a = b + 133 * c - (a + 134) / 2
+	a = b + 134 * c - (a + 135) / 2
+	a = b + 135 * c - (a + 136) / 2
+	a = b + 136 * c - (a + 137) / 2
+	a = b + 137 * c - (a + 138) / 2
+	a = b + 138 * c - (a + 139) / 2
+	a = b + 139 * c - (a + 140) / 2
+	a = b + 140 * c - (a + 141) / 2
+	a = b + 141 * c - (a + 142) / 2
+	a = b + 142 * c - (a + 143) / 2
+	a = b + 143 * c - (a + 144) / 2
+	a = b + 144 * c - (a + 145) / 2
+	a = b + 145 * c - (a + 146) / 2
+	a = b + 146 * c - (a + 147) / 2
+	a = b + 147 * c - (a + 148) / 2
+	a = b + 148 * c - (a + 149) / 2
+	a = b + 149 * c - (a + 150) / 2
+	a = b + 150 * c - (a + 151) / 2
+	a = b + 151 * c - (a + 152) / 2
+	a = b + 152 * c - (a + 153) / 2
+	a = b + 153 * c - (a + 154) / 2
+	a = b + 154 * c - (a + 155) / 2
+	a = b + 155 * c - (a + 156) / 2
+	a = b + 156 * c - (a + 157) / 2
+	a = b + 157 * c - (a + 158) / 2
+	a = b + 158 * c - (a + 159) / 2
+	a = b + 159 * c - (a + 160) / 2
+	a = b + 160 * c - (a + 161) / 2
+	a = b + 161 * c - (a + 162) / 2
+	a = b + 162 * c - (a + 163) / 2
+	a = b + 163 * c - (a + 164) / 2
+	a = b + 164 * c - (a + 165) / 2
+	a = b + 165 * c - (a + 166) / 2
+	a = b + 166 * c - (a + 167) / 2
+	a = b + 167 * c - (a + 168) / 2
+	a = b + 168 * c - (a + 169) / 2
+	a = b + 169 * c - (a + 170) / 2
+	a = b + 170 * c - (a + 171) / 2
+	a = b + 171 * c - (a + 172) / 2
+	a = b + 172 * c - (a + 173) / 2
+	a = b + 173 * c - (a + 174) / 2
+	a = b + 174 * c - (a + 175) / 2
+	a = b + 175 * c - (a + 176) / 2
+	a = b + 176 * c - (a + 177) / 2
+	a = b + 177 * c - (a + 178) / 2
+	a = b + 178 * c - (a + 179) / 2
+	a = b + 179 * c - (a + 180) / 2
+	a = b + 180 * c - (a + 181) / 2
+	a = b + 181 * c - (a + 182) / 2
+	a = b + 182 * c - (a + 183) / 2
+	a = b + 183 * c - (a + 184) / 2
+	a = b + 184 * c - (a + 185) / 2
+	a = b + 185 * c - (a + 186) / 2
+	a = b + 186 * c - (a + 187) / 2
+	a = b + 187 * c - (a + 188) / 2
+	a = b + 188 * c - (a + 189) / 2
+	a = b + 189 * c - (a + 190) / 2
+	a = b + 190 * c - (a + 191) / 2
+	a = b + 191 * c - (a + 192) / 2
+	a = b + 192 * c - (a + 193) / 2
+	a = b + 193 * c - (a + 194) / 2
+	a = b + 194 * c - (a + 195) / 2
+	a = b + 195 * c - (a + 196) / 2
+	a = b + 196 * c - (a + 197) / 2
+	a = b + 197 * c - (a + 198) / 2
+	a = b + 198 * c - (a + 199) / 2
+	a = b + 199 * c - (a + 200) / 2
+	a = b + 200 * c - (a + 201) / 2
+	a = b + 201 * c - (a + 202) / 2
+	a = b + 202 * c - (a + 203) / 2
+	a = b + 203 * c - (a + 204) / 2
+	a = b + 204 * c - (a + 205) / 2
+	a = b + 205 * c - (a + 206) / 2
+	a = b + 206 * c - (a + 207) / 2
+	a = b + 207 * c - (a + 208) / 2
+	a = b + 208 * c - (a + 209) / 2
+	a = b + 209 * c - (a + 210) / 2
+	a = b + 210 * c - (a + 211) / 2
+	a = b + 211 * c - (a + 212) / 2
+	a = b + 212 * c - (a + 213) / 2
+	a = b + 213 * c - (a + 214) / 2
+	a = b + 214 * c - (a + 215) / 2
+	a = b + 215 * c - (a + 216) / 2
+	a = b + 216 * c - (a + 217) / 2
+	a = b + 217 * c - (a + 218) / 2
+	a = b + 218 * c - (a + 219) / 2
+	a = b + 219 * c - (a + 220) / 2
+	a = b + 220 * c - (a + 221) / 2
+	a = b + 221 * c - (a + 222) / 2
+	a = b + 222 * c - (a + 223) / 2
+	a = b + 223 * c - (a + 224) / 2
+	a = b + 224 * c - (a + 225) / 2
+	a = b + 225 * c - (a + 226) / 2
+	a = b + 226 * c - (a + 227) / 2
+	a = b + 227 * c - (a + 228) / 2
+	a = b + 228 * c - (a + 229) / 2
+	a = b + 229 * c - (a + 230) / 2
+	a = b + 230 * c - (a + 231) / 2
+	a = b + 231 * c - (a + 232) / 2
+	a = b + 232 * c - (a + 233) / 2
+	a = b + 233 * c - (a + 234) / 2
+	a = b + 234 * c - (a + 235) / 2
+	a = b + 235 * c - (a + 236) / 2
+	a = b + 236 * c - (a + 237) / 2
+	a = b + 237 * c - (a + 238) / 2
+	a = b + 238 * c - (a + 239) / 2
+	a = b + 239 * c - (a + 240) / 2
+	a = b + 240 * c - (a + 241) / 2
+	a = b + 241 * c - (a + 242) / 2
+	a = b + 242 * c - (a + 243) / 2
+	a = b + 243 * c - (a + 244) / 2
+	a = b + 244 * c - (a + 245) / 2
+	a = b + 245 * c - (a + 246) / 2
+	a = b + 246 * c - (a + 247) / 2
+	a = b + 247 * c - (a + 248) / 2
+	a = b + 248 * c - (a + 249) / 2
+	a = b + 249 * c - (a + 250) / 2
+	a = b + 250 * c - (a + 251) / 2
+	a = b + 251 * c - (a + 252) / 2
+	a = b + 252 * c - (a + 253) / 2
+	a = b + 253 * c - (a + 254) / 2
+	a = b + 254 * c - (a + 255) / 2
+	a = b + 255 * c - (a + 256) / 2
+	a = b + 256 * c - (a + 257) / 2
+	a = b + 257 * c - (a + 258) / 2
+	a = b + 258 * c - (a + 259) / 2
+	a = b + 259 * c - (a + 260) / 2
+	a = b + 260 * c - (a + 261) / 2
+	a = b + 261 * c - (a + 262) / 2
+	a = b + 262 * c - (a + 263) / 2
+	a = b + 263 * c - (a + 264) / 2
+	a = b + 264 * c - (a + 265) / 2
+	a = b + 265 * c - (a + 266) / 2
+	a = b + 266 * c - (a + 267) / 2
+	a = b + 267 * c - (a + 268) / 2
+	a = b + 268 * c - (a + 269) / 2
+	a = b + 269 * c - (a + 270) / 2
+	a = b + 270 * c - (a + 271) / 2
+	a = b + 271 * c - (a + 272) / 2
+	a = b + 272 * c - (a + 273) / 2
+	a = b + 273 * c - (a + 274) / 2
+	a = b + 274 * c - (a + 275) / 2
+	a = b + 275 * c - (a + 276) / 2
+	a = b + 276 * c - (a + 277) / 2
+	a = b + 277 * c - (a + 278) / 2
+	a = b + 278 * c - (a + 279) / 2
+	a = b + 279 * c - (a + 280) / 2
+	a = b + 280 * c - (a + 281) / 2
+	a = b + 281 * c - (a + 282) / 2
+	a = b + 282 * c - (a + 283) / 2
+	a = b + 283 * c - (a + 284) / 2
+	a = b + 284 * c - (a + 285) / 2
+	a = b + 285 * c - (a + 286) / 2
+	a = b + 286 * c - (a + 287) / 2
+	a = b + 287 * c - (a + 288) / 2
+	a = b + 288 * c - (a + 289) / 2
+	a = b + 289 * c - (a + 290) / 2
+	a = b + 290 * c - (a + 291) / 2
+	a = b + 291 * c - (a + 292) / 2
+	a = b + 292 * c - (a + 293) / 2
+	a = b + 293 * c - (a + 294) / 2
+	a = b + 294 * c - (a + 295) / 2
+	a = b + 295 * c - (a + 296) / 2
+	a = b + 296 * c - (a + 297) / 2
+	a = b + 297 * c - (a + 298) / 2
+	a = b + 298 * c - (a + 299) / 2
+	a = b + 299 * c - (a + 300) / 2
+end function
+
+
+function hot()
+	dim i, acc
+	for i = 1 to 200000
+		acc = acc + i * 3 - (i / 2) + x
+		if acc > 1000000
+			acc = acc - 1000000
+		end if
+	end for
+	return acc
+end function
+
+
+function main()
+	print "bench_exprs", hot()
+end function
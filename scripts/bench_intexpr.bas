@@ -0,0 +1,18 @@
+# benchmark: integer expression throughput.
+# every opcode the parser emits for int expressions appears in the inner loop.
+
+function main()
+	dim i, a, b = 7, c = 3, acc
+	for i = 1 to 300000
+		a = (i + b) * c - i / c
+		acc = acc + a - (b * c + 1) / 2
+		if a > b && c < a || a == b
+			acc = acc + 1
+		end if
+		if a >= i && b <= c || a != c
+			acc = acc - 1
+		end if
+		acc = acc - acc / 1000 * 1000
+	end for
+	print "bench_intexpr", acc
+end function
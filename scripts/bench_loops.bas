@@ -0,0 +1,33 @@
+# benchmark: loop-heavy script, modelled on split() in advent2.bas.
+# compare dispatch modes: --tree, --nosuper, and a -DDBAS_NO_THREADED build.
+
+function countwords(string str)
+	dim i, words, inword
+	for i = 0 to len(str) - 1
+		if str[i] == 32 || str[i] == 9
+			inword = 0
+		else if inword == 0
+			inword = 1
+			words = words + 1
+		end if
+	end for
+	return words
+end function
+
+
+function main()
+	dim i, j, acc
+	dim string line = "the quick brown fox	jumps over the lazy dog  again and again"
+	for i = 1 to 20000
+		acc = acc + countwords(line)
+	end for
+	i = 0
+	while i < 300000
+		j = i * 2 + 1
+		if j > 1000
+			acc = acc + 1
+		end if
+		i = i + 1
+	end while
+	print "bench_loops", acc
+end function
@@ -0,0 +1,42 @@
+# benchmark: member access on arrays of user types, as in advent2's room lookups.
+
+type room_t
+	dim string name
+	dim string exit_n
+	dim string exit_s
+	dim x
+	dim y
+end type
+
+dim room_t[] rooms
+dim croom = 0
+
+
+function buildrooms()
+	dim i
+	dim room_t r
+	for i = 0 to 9
+		let r.name = "room"
+		let r.exit_n = "n"
+		let r.x = i
+		let r.y = i * 2
+		push(rooms, r)
+	end for
+end function
+
+
+function main()
+	dim i, acc
+	buildrooms()
+	for i = 1 to 200000
+		croom = i - i / 10 * 10
+		if rooms[croom].exit_n != ""
+			acc = acc + rooms[croom].x
+		end if
+		if rooms[croom].exit_s == ""
+			acc = acc + rooms[croom].y - rooms[croom].x
+		end if
+		rooms[croom].y = rooms[croom].y + 1
+	end for
+	print "bench_members", acc, rooms[9].y
+end function
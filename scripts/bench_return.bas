@@ -0,0 +1,63 @@
+# benchmark: functions returning strings, arrays and user types. results move into their destination.
+
+type item_t
+	dim string name
+	dim weight
+end type
+
+type room_t
+	dim string name
+	dim string description
+	dim item_t[] items
+end type
+
+
+function main()
+	dim i, total
+	dim string s
+	dim string[] words
+	dim room_t r
+	dim room_t[] rooms
+	for i = 1 to 2000
+		words = wordlist(100)
+		total = total + len(words)
+		r = mkroom(i)
+		push(rooms, mkroom(i))
+		s = label(i)
+		total = total + len(s) + len(r.items)
+	end for
+	print total, len(rooms), rooms[1999].items[9].weight
+end function
+
+
+function string[] wordlist(int n)
+	dim i
+	dim string[] a
+	for i = 1 to n
+		push(a, "word")
+	end for
+	return a
+end function
+
+function room_t mkroom(int n)
+	dim i
+	dim room_t r
+	dim item_t it
+	r.name = "room"
+	r.description = "a long and winding description of the room"
+	for i = 0 to 9
+		it.name = "item"
+		it.weight = n + i
+		push(r.items, it)
+	end for
+	return r
+end function
+
+function string label(int n)
+	dim i
+	dim string s
+	for i = 1 to 20
+		s = s + "label "
+	end for
+	return s
+end function
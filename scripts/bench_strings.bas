@@ -0,0 +1,29 @@
+# benchmark: string character reads and writes, len() and whole-string copies.
+
+function rot(string s, int n)
+	dim i
+	for i = 0 to len(s) - 1
+		if s[i] >= 97 && s[i] <= 122
+			s[i] = (s[i] - 97 + n) - ((s[i] - 97 + n) / 26) * 26 + 97
+		end if
+	end for
+	print s
+end function
+
+
+function main()
+	dim i, j, acc
+	dim string text = "the quick brown fox jumps over the lazy dog"
+	dim string copy
+	for i = 1 to 20000
+		copy = text
+		for j = 0 to len(copy) - 1
+			acc = acc + copy[j]
+		end for
+		copy[0] = copy[0] - 32
+	end for
+	print copy
+	rot(text, 13)
+	print text
+	print "bench_strings", acc
+end function
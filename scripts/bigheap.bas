@@ -0,0 +1,12 @@
+# allocates more than 2^19 pages: 600000 strings live at once in one array.
+# expected output:  600000 x599999
+
+function main()
+	dim i
+	dim string[] a
+	for i = 0 to 599999
+		push(a, "x" + "")
+	end for
+	a[599999] = "x599999"
+	print len(a), a[599999]
+end function
@@ -0,0 +1,63 @@
+# regression: an object passed by reference stays part of the caller's variable,
+# even when the callee copies a container it lives in before writing to it.
+# expected output:  changed orig  /  changed orig  /  3 2  /  changed orig
+
+type item_t
+	dim string name
+end type
+
+type bag_t
+	dim item_t[] items
+	dim int[] nums
+end type
+
+dim bag_t gb
+dim bag_t gcopy
+
+
+function main()
+	dim item_t it
+	dim bag_t lb
+	it.name = "orig"
+	push(gb.items, it)
+	push(gb.nums, 1)
+	push(gb.nums, 2)
+	# the callee copies the container, then writes through the reference
+	rename(gb.items[0])
+	print gb.items[0].name, gcopy.items[0].name
+	# the copy is made while the path's index is computed
+	gb.items[0].name = "orig"
+	named(gb.items[first()])
+	print gb.items[0].name, gcopy.items[0].name
+	# arrays too
+	grow(gb.nums)
+	print len(gb.nums), len(gcopy.nums)
+	# a local container, copied into a global
+	push(lb.items, it)
+	keep(lb.items[0], lb)
+	print lb.items[0].name, gcopy.items[0].name
+end function
+
+function rename(item_t p)
+	gcopy = gb
+	p.name = "changed"
+end function
+
+function named(item_t p)
+	p.name = "changed"
+end function
+
+function int first()
+	gcopy = gb
+	return 0
+end function
+
+function grow(int[] n)
+	gcopy = gb
+	push(n, 3)
+end function
+
+function keep(item_t p, bag_t b)
+	gcopy = b
+	p.name = "changed"
+end function
@@ -0,0 +1,27 @@
+#!/bin/bash
+# generate a synthetic parser-scaling benchmark: scripts/bench_parse_<n>.bas
+# with n globals, n functions and n/10 types, each function using globals, members, calls and
+# its own string literal.
+# usage: scripts/genbench.sh 10000 && ./dbas bench_parse_10000
+n=${1:-10000}
+out="$(dirname "$0")/bench_parse_$n.bas"
+awk -v n="$n" 'BEGIN {
+	nt = int(n / 10);  if (nt < 1) nt = 1
+	for (t = 0; t < nt; t++) {
+		printf "type T%d\n\tdim a%d\n\tdim string s%d\n\tdim b%d\nend type\n", t, t, t, t
+	}
+	for (i = 0; i < n; i++)
+		printf "dim g%d = %d\n", i, i
+	for (t = 0; t < nt; t++)
+		printf "dim T%d o%d\n", t, t
+	for (i = 0; i < n; i++) {
+		t = i % nt
+		printf "function f%d(int x)\n\tdim y = x\n", i
+		printf "\tdim string d = \"a long and winding description of function number %d\"\n", i
+		printf "\to%d.b%d = g%d + y\n", t, t, i
+		if (i > 0)  printf "\ty = f%d(y - 1)\n", i - 1
+		printf "\treturn y + o%d.a%d\nend function\n", t, t
+	}
+	printf "function main()\n\tprint \"bench_parse\", f%d(0)\nend function\n", (n > 100 ? 99 : n - 1)
+}' > "$out"
+echo "wrote $out"
@@ -0,0 +1,31 @@
+#!/bin/bash
+# generate a synthetic multi-file project benchmark: scripts/bench_project_<n>/ with n files.
+# file 0 is the program; every other file is module m<i>, with k functions that call into the
+# module before it (main calls down the whole chain), its own globals, and a type shared by every file.
+# usage: scripts/genproject.sh 200 && ./dbas bench_project_200 --threads 4
+n=${1:-200}
+k=${2:-50}
+dir="$(dirname "$0")/bench_project_$n"
+mkdir -p "$dir"
+rm -f "$dir"/*.bas
+for ((m = 0; m < n; m++)); do
+	awk -v m="$m" -v n="$n" -v k="$k" 'BEGIN {
+		if (m > 0)  printf "module m%d\n", m
+		printf "type P\n\tdim a\n\tdim string s\nend type\n"
+		for (i = 0; i < k; i++)  printf "dim g%d = %d\n", i, i
+		printf "dim P o\n"
+		if (m == 0) {
+			printf "function main()\n\tprint \"bench_project\", m%d:f%d(1)\nend function\n", n - 1, k - 1
+			exit
+		}
+		for (i = 0; i < k; i++) {
+			printf "function f%d(int x)\n\tdim y = x\n", i
+			printf "\tdim string d = \"module %d function %d\"\n", m, i
+			printf "\to.a = g%d + y\n", i
+			if      (i > 0)  printf "\ty = f%d(y) + 1\n", i - 1
+			else if (m > 1)  printf "\ty = m%d:f0(y)\n", m - 1
+			printf "\treturn y\nend function\n"
+		}
+	}' > "$dir/$(printf "%04d" "$m").bas"
+done
+echo "wrote $dir ($n files)"
@@ -0,0 +1,38 @@
+# regression: a write's destination path is worked out before its value,
+# so a value that changes the path's index still writes to the old index.
+# expected output:  7 0 0  /  1 0  /  xb
+
+type bag_t
+	dim int[] nums
+end type
+
+dim i
+
+
+function main()
+	dim int[] a
+	dim bag_t[] bags
+	dim bag_t b
+	dim string s
+	push(a, 0)
+	push(a, 0)
+	push(a, 0)
+	a[i] = bump()
+	print a[0], a[1], a[2]
+	# push: the array first
+	push(bags, b)
+	push(bags, b)
+	i = 0
+	push(bags[i].nums, bump())
+	print len(bags[0].nums), len(bags[1].nums)
+	# string characters
+	s = "ab"
+	i = 0
+	s[i] = bump() + 113
+	print s
+end function
+
+function int bump()
+	i = i + 1
+	return 7
+end function
@@ -0,0 +1,141 @@
+// ----------------------------------------
+// Call tracer
+// ----------------------------------------
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <charconv>
+#include <csignal>
+#include "dbas7.hpp"
+using namespace std;
+
+
+// Writes begin / end events for function calls, system calls and input waits in the Chrome
+// trace-event format (chrome://tracing, Perfetto). The interpreter only stores a timestamp into a
+// single-producer ring buffer; a background thread drains it to the file and adds an fstack
+// depth counter. When the buffer is full, new calls go untraced rather than waiting: a begin
+// event is only taken if there is room left for the end events of every call still open.
+struct Tracer {
+	enum Kind : uint8_t { FUNC = 1, SYS, INPUT };
+	struct Event { int64_t ts; int32_t id; uint8_t kind; char ph; };
+	static const size_t CAPACITY = 1 << 20;  // events. power of two
+	static const int    FLUSH_MS = 2;
+
+	vector<Event>    ring;
+	atomic<size_t>   head{0}, tail{0};  // written by the interpreter / by the flush thread
+	vector<uint8_t>  open;              // kind of each open call, 0 if it was dropped
+	size_t           nopen = 0,  dropped = 0,  events = 0;
+	int64_t          t0 = 0;
+	FILE*            fp = NULL;
+	thread           flusher;
+	atomic<int>      running{0};
+	int32_t          depth = 0;         // flush thread: function depth written so far
+	string           out;               // flush thread: JSON not yet written
+	vector<string>   names, prompts;    // escaped for JSON, by function / input index
+
+	~Tracer() { stop(); }
+
+
+	// === record (interpreter thread) ===
+
+	static int64_t now() {
+		return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+	void push(const Event& e) {
+		size_t h = head.load(memory_order_relaxed);
+		ring[h & (CAPACITY - 1)] = e;
+		head.store(h + 1, memory_order_release);
+	}
+	void begin(Kind kind, int32_t id) {
+		size_t used = head.load(memory_order_relaxed) - tail.load(memory_order_acquire);
+		if (CAPACITY - used <= nopen + 1)  return open.push_back(0),  (void)dropped++;
+		push({ now() - t0, id, kind, 'B' });
+		open.push_back(kind),  nopen++;
+	}
+	void end() {
+		uint8_t kind = open.back();
+		open.pop_back();
+		if (kind)  push({ now() - t0, 0, kind, 'E' }),  nopen--;  // room was kept for it
+	}
+
+
+	// === flush (background thread) ===
+
+	int start(const Prog& p, const string& fname) {
+		if (!(fp = fopen(fname.c_str(), "w")))  return fprintf(stderr, "could not open file: %s\n", fname.c_str()), 1;
+		ring.resize(CAPACITY),  t0 = now();
+		for (auto& fn : p.functions)  names.push_back(json(fn.name));
+		for (auto& in : p.inputs)     prompts.push_back(json(in.prompt));
+		out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+			"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"dbas " + json(p.module) + "\"}}";
+		running = 1;
+		flusher = thread([this]() {
+			sigset_t prof;  // leave the profiler's samples to the interpreter thread
+			sigemptyset(&prof),  sigaddset(&prof, SIGPROF);
+			pthread_sigmask(SIG_BLOCK, &prof, NULL);
+			while (running)
+				if (!drain())  this_thread::sleep_for(chrono::milliseconds(FLUSH_MS));
+			drain();
+		});
+		return 0;
+	}
+	void stop() {
+		if (!fp)  return;
+		running = 0;
+		flusher.join();
+		out += "\n]}\n";
+		fwrite(out.data(), 1, out.size(), fp);
+		fclose(fp),  fp = NULL;
+	}
+
+	// write out what the interpreter has recorded so far. returns the number of events
+	size_t drain() {
+		size_t t = tail.load(memory_order_relaxed),  h = head.load(memory_order_acquire),  n = h - t;
+		for ( ; t != h; t++)  write( ring[t & (CAPACITY - 1)] );
+		tail.store(t, memory_order_release);
+		events += n;
+		return n;
+	}
+	void write(const Event& e) {
+		if      (e.ph == 'E')      out += ",\n{\"ph\":\"E\"";
+		else if (e.kind == FUNC)   out += ",\n{\"cat\":\"function\",\"ph\":\"B\",\"name\":\"",  out += names[e.id],  out += '"';
+		else if (e.kind == SYS)    out += ",\n{\"cat\":\"system\",\"ph\":\"B\",\"name\":\"",  out += sysname((Sys)e.id),  out += '"';
+		else                       out += ",\n{\"cat\":\"input\",\"ph\":\"B\",\"name\":\"input\",\"args\":{\"prompt\":\"",  out += prompts[e.id],  out += "\"}";
+		stamp(e.ts),  out += '}';
+		if (e.kind == FUNC)
+			depth += e.ph == 'B' ? 1 : -1,
+			out += ",\n{\"name\":\"fstack\",\"ph\":\"C\",\"args\":{\"depth\":",  num(depth),  out += '}',  stamp(e.ts),  out += '}';
+		if (out.size() > (1 << 16))  fwrite(out.data(), 1, out.size(), fp),  out.clear();
+	}
+	// ,"ts":<microseconds>,"pid":1,"tid":1
+	void stamp(int64_t ns) {
+		out += ",\"ts\":",  num(ns / 1000),  out += '.';
+		char frac[3] = { char('0' + ns / 100 % 10), char('0' + ns / 10 % 10), char('0' + ns % 10) };
+		out.append(frac, 3),  out += ",\"pid\":1,\"tid\":1";
+	}
+	void num(int64_t n) {
+		char buf[24];
+		out.append(buf, to_chars(buf, buf + sizeof(buf), n).ptr - buf);
+	}
+	static const char* sysname(Sys sys) {
+		switch (sys) {
+		case Sys::push:      return "push";
+		case Sys::pop:       return "pop";
+		case Sys::len:       return "len";
+		case Sys::default_:  return "default";
+		default:             return "<BAD_SYS>";
+		}
+	}
+	static string json(const string& s) {
+		string out;
+		for (char c : s)
+			if      (c == '"' || c == '\\')  out += '\\',  out += c;
+			else if ((unsigned char)c < 0x20)  out += ' ';
+			else    out += c;
+		return out;
+	}
+};
@@ -0,0 +1,245 @@
+// ----------------------------------------
+// Bytecode virtual machine
+// ----------------------------------------
+#pragma once
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "dbas7.hpp"
+#include "runtime.hpp"
+#include "compiler.hpp"
+using namespace std;
+
+
+// dispatch mode. build with -DDBAS_NO_THREADED to force the portable switch
+#if defined(__GNUC__) && !defined(DBAS_NO_THREADED)
+	#define DBAS_THREADED 1
+#else
+	#define DBAS_THREADED 0
+#endif
+
+
+// Runs compiled Bytecode in a single dispatch loop. Memory, frames and the
+// expression stacks are shared with Runtime, which stays available as the
+// tree-walking reference mode (Runtime::run).
+struct VM : Runtime {
+	struct RetFrame { int32_t pc, func; };
+	Bytecode          bc;
+	vector<Ref>       rstack;  // variable reference stack
+	vector<RetFrame>  cstack;  // return addresses
+	vector<int32_t>   holds;   // call results passed by reference, dropped once the call returns
+	vector<const void*> tcode; // threaded code: handler address per instruction
+	Prog::Dsym        callsite = { 0, 0 };  // of the next call (census builds)
+	static constexpr const char* DISPATCH = DBAS_THREADED ? "threaded" : "switch";
+
+
+	void compile(int superinstr=1) {
+		Compiler c(prog);
+		c.superinstr = superinstr;
+		c.profile    = profile;
+		c.trace      = trace;
+		c.census     = census;
+		bc = c.compile();
+		tcode = {};
+	}
+
+	int32_t run() {
+		reset();
+		if (profile)  prof.start(prog);
+		if (census)   cen.start(heap, funcindex("main"));
+		int32_t rval = exec(0);
+		if (profile)  prof.stop();
+		return rval;
+	}
+
+
+	// reference stack operations
+	Ref&  rpeek() { return rstack.at(rstack.size() - 1); }
+	Ref   rpop () { auto r = rstack.at(rstack.size() - 1);  rstack.pop_back();  return r; }
+	void  rpush(int32_t* r) { rstack.push_back({ r, NULL }); }
+
+
+	// main loop. direct-threaded (labels-as-values) on GCC / Clang, portable switch otherwise
+	int32_t exec(int32_t pc) {
+		const Bytecode::Instr* code = bc.code.data();
+		const Bytecode::Instr* in   = NULL;
+		int32_t t = 0, u = 0;
+		string_view s, q;
+
+		#if DBAS_THREADED
+			static const void* LABELS[] = {
+				#define X(name)  &&L_##name,
+				DBAS_OPS(X)
+				#undef X
+			};
+			// translate each instruction to its handler address once per compile
+			if (tcode.size() != bc.code.size()) {
+				tcode.resize(bc.code.size());
+				for (size_t i = 0; i < bc.code.size(); i++)
+					tcode[i] = LABELS[(int)bc.code[i].op];
+			}
+			const void* const* tc = tcode.data();
+			#define VM_OP(name)  L_##name:
+			#define VM_NEXT      in = &code[pc];  goto *tc[pc++];
+			VM_NEXT
+		#else
+			#define VM_OP(name)  case Op::name:
+			#define VM_NEXT      continue;
+			while (true) {
+			in = &code[pc++];
+			switch (in->op) {
+		#endif
+
+		VM_OP(noop)         VM_NEXT
+		// integers
+		VM_OP(i)            ipush(in->a);  VM_NEXT
+		VM_OP(add)          t = ipop(),  ipeek() += t;  VM_NEXT
+		VM_OP(sub)          t = ipop(),  ipeek() -= t;  VM_NEXT
+		VM_OP(mul)          t = ipop(),  ipeek() *= t;  VM_NEXT
+		VM_OP(div)          t = ipop(),  ipeek() /= t;  VM_NEXT
+		VM_OP(and_)         t = ipop(),  ipeek()  = ipeek() && t;  VM_NEXT
+		VM_OP(or_)          t = ipop(),  ipeek()  = ipeek() || t;  VM_NEXT
+		VM_OP(eq)           t = ipop(),  u = ipop(),  ipush(u == t);  VM_NEXT
+		VM_OP(neq)          t = ipop(),  u = ipop(),  ipush(u != t);  VM_NEXT
+		VM_OP(lt)           t = ipop(),  u = ipop(),  ipush(u <  t);  VM_NEXT
+		VM_OP(gt)           t = ipop(),  u = ipop(),  ipush(u >  t);  VM_NEXT
+		VM_OP(lte)          t = ipop(),  u = ipop(),  ipush(u <= t);  VM_NEXT
+		VM_OP(gte)          t = ipop(),  u = ipop(),  ipush(u >= t);  VM_NEXT
+		// strings
+		VM_OP(lit)          spush(in->a);  VM_NEXT
+		VM_OP(strcat)       strcat();  VM_NEXT
+		VM_OP(eq_str)       s = spop(),  q = spop(),  ipush(q == s);  VM_NEXT
+		VM_OP(neq_str)      s = spop(),  q = spop(),  ipush(q != s);  VM_NEXT
+		// variable references
+		VM_OP(ref_local)    rpush( &get(in->a) );  VM_NEXT
+		VM_OP(ref_global)   rpush( &get_global(in->a) );  VM_NEXT
+		VM_OP(ref_index)    t = ipop(),  rpeek().ptr = &memget(*rpeek().ptr, t);  VM_NEXT
+		VM_OP(ref_prop)     rpeek().ptr = &memget(*rpeek().ptr, in->a);  VM_NEXT
+		VM_OP(ref_chr)      t = ipop(),  rpeek() = { NULL, &memget_chr(*rpeek().ptr, t) };  VM_NEXT
+		VM_OP(ref_index_w)  t = ipop(),  rpeek().ptr = &memwrite(*rpeek().ptr).mem.at(t);  VM_NEXT
+		VM_OP(ref_prop_w)   rpeek().ptr = &memwrite(*rpeek().ptr).mem.at(in->a);  VM_NEXT
+		VM_OP(ref_chr_w)    t = ipop(),  rpeek() = { NULL, &memwrite(*rpeek().ptr).str.at(t) };  VM_NEXT
+		VM_OP(ref_index_at) t = vals[vals.size() - in->a].v,  rpeek().ptr = &memwrite(*rpeek().ptr).mem.at(t);  VM_NEXT  // index left a slots down
+		VM_OP(ref_chr_at)   t = vals[vals.size() - in->a].v,  rpeek() = { NULL, &memwrite(*rpeek().ptr).str.at(t) };  VM_NEXT
+		VM_OP(pin)          pin( *rpeek().ptr );  VM_NEXT
+		VM_OP(load)         ipush( rpop().get() );  VM_NEXT
+		VM_OP(load_str)     spush_ref( *rpop().ptr );  VM_NEXT
+		// assignment
+		VM_OP(store)        t = ipop(),  rpop().set(t);  VM_NEXT
+		VM_OP(store_str)    spop_to( *rpop().ptr );  VM_NEXT
+		VM_OP(append_str)   appendstr( spop(), *rpop().ptr );  VM_NEXT
+		VM_OP(store_obj)    t = ipop(),  u = *rpop().ptr;  if (u != t)  cloneto(t, u);  VM_NEXT
+		VM_OP(store_move)   t = ipop(),  moveto(t, *rpop().ptr);  VM_NEXT
+		VM_OP(dim_make)     *rpop().ptr = make( bc.types[in->a] );  VM_NEXT
+		VM_OP(dim_str)      *rpop().ptr = spop_new();  VM_NEXT
+		VM_OP(dim_clone)    t = ipop(),  *rpop().ptr = clone2( bc.types[in->a], t );  VM_NEXT
+		VM_OP(inc)          { Ref r = rpop();  r.set(r.get() + in->a); }  VM_NEXT
+		// control
+		VM_OP(jmp)          pc = in->a;  VM_NEXT
+		VM_OP(jz)           if (!ipop())  pc = in->a;  VM_NEXT
+		VM_OP(jnz)          if (ipop())  pc = in->a;  VM_NEXT
+		VM_OP(call)         pc = enter(in->a, pc, in->b);  VM_NEXT
+		VM_OP(ret)          pc = leave();  VM_NEXT
+		VM_OP(ret_str)      sown( prog.functions[in->a] ),  pc = leave();  VM_NEXT
+		VM_OP(ret_obj)      ipeek() = clone(ipeek()),  pc = leave();  VM_NEXT
+		VM_OP(ret_new)      push_default( prog.functions[in->a].type ),  pc = leave();  VM_NEXT
+		VM_OP(pop)          ipop();  VM_NEXT
+		VM_OP(pop_str)      spop();  VM_NEXT
+		VM_OP(pop_obj)      destroy(ipop());  VM_NEXT
+		VM_OP(hold)         holds.push_back(ipeek());  VM_NEXT
+		VM_OP(unhold)       for (t = 0; t < in->a; t++)  destroy(holds.back()),  holds.pop_back();  VM_NEXT
+		VM_OP(unpin)        unpin( pins.size() - in->a );  VM_NEXT
+		VM_OP(halt)         return ipop();
+		// system functions
+		VM_OP(sys_push)     sys_push(in->a, in->b);  VM_NEXT
+		VM_OP(sys_pop)      sys_pop(in->a);  VM_NEXT
+		VM_OP(sys_len)      ipush( memsize(ipop()) );  VM_NEXT
+		VM_OP(sys_len_str)  ipush( spop().size() );  VM_NEXT
+		VM_OP(sys_default)  materialize(),  unmake_default( ipop() ),  ipush(0);  VM_NEXT
+		// I/O
+		VM_OP(print_int)    printf("%d", ipop() );  VM_NEXT
+		VM_OP(print_str)    sprint( spop() );  VM_NEXT
+		VM_OP(print_lit)    sprint( prog.literals[in->a] );  VM_NEXT
+		VM_OP(print_nl)     printf("\n");  VM_NEXT
+		VM_OP(input)        r_input_to(in->a, *rpop().ptr);  VM_NEXT
+		// superinstructions
+		VM_OP(load_local)   ipush( get(in->a) );  VM_NEXT
+		VM_OP(load_global)  ipush( get_global(in->a) );  VM_NEXT
+		VM_OP(add_i)        ipeek() += in->a;  VM_NEXT
+		VM_OP(sub_i)        ipeek() -= in->a;  VM_NEXT
+		VM_OP(inc_local)    get(in->a) += in->b;  VM_NEXT
+		VM_OP(jz_eq)        t = ipop(),  u = ipop();  if (!(u == t))  pc = in->a;  VM_NEXT
+		VM_OP(jz_neq)       t = ipop(),  u = ipop();  if (!(u != t))  pc = in->a;  VM_NEXT
+		VM_OP(jz_lt)        t = ipop(),  u = ipop();  if (!(u <  t))  pc = in->a;  VM_NEXT
+		VM_OP(jz_gt)        t = ipop(),  u = ipop();  if (!(u >  t))  pc = in->a;  VM_NEXT
+		VM_OP(jz_lte)       t = ipop(),  u = ipop();  if (!(u <= t))  pc = in->a;  VM_NEXT
+		VM_OP(jz_gte)       t = ipop(),  u = ipop();  if (!(u >= t))  pc = in->a;  VM_NEXT
+		VM_OP(jnz_lt)       t = ipop(),  u = ipop();  if (u <  t)  pc = in->a;  VM_NEXT
+		VM_OP(jnz_gt)       t = ipop(),  u = ipop();  if (u >  t)  pc = in->a;  VM_NEXT
+		// profiling
+		VM_OP(line)         prof.line({ in->a, in->b });  VM_NEXT
+		VM_OP(trace_sys)    if (trace)  tracer.begin(Tracer::SYS, in->a);  VM_NEXT
+		VM_OP(trace_end)    if (trace)  tracer.end();  VM_NEXT
+		VM_OP(site)         callsite = { in->a, in->b };  VM_NEXT
+
+		#if !DBAS_THREADED
+			default:  throw runtime_error(string("unknown op: ") + opname(in->op));
+			}  // end switch
+			}  // end while
+		#endif
+		#undef VM_OP
+		#undef VM_NEXT
+	}
+
+
+	// function calls
+	int32_t enter(int32_t fidx, int32_t retpc, int32_t target) {
+		const auto& fn = prog.functions[fidx];
+		pos_t base = vstack.size(),  argc = fn.args.size();
+		// arguments were pushed in order, so pop them back to front into the new frame
+		frame_push(base, argc + fn.locals.size());
+		for (pos_t i = argc - 1; i >= 0; i--)
+			if    (fn.args[i].type == "string")  vstack[base + i] = spop_new();  // new string by value
+			else  vstack[base + i] = ipop();
+		materialize();  // the call may change strings the caller is viewing
+		if (profile)  prof.enter(fidx, fn.dsym);
+		if (trace)    tracer.begin(Tracer::FUNC, fidx);
+		if (census)   cen.enter(fidx, callsite);
+		cstack.push_back({ retpc, fidx });
+		return target;
+	}
+	int32_t leave() {
+		auto rf = cstack.back();
+		cstack.pop_back();
+		if (profile)  prof.unwind(prog.functions[rf.func].dsym);
+		frame_leave( prog.functions[rf.func] );  // return value stays on the value stack
+		if (profile)  prof.leave();
+		if (trace)    tracer.end();
+		if (census)   cen.leave();
+		return rf.pc;
+	}
+	// the result of a function that ends without return
+	void push_default(const string& type) {
+		if    (type == "string")  spush_tmp("");
+		else  ipush( make(type) );  // 0 for int
+	}
+
+	// the array is on top, then the value, then the n indexes of the array's path. n = -1: the array is a call's result, below the value
+	void sys_push(int32_t kind, int32_t n) {
+		int32_t val = 0,  arr = n < 0 ? vals[vals.size() - 2].v : ipop();
+		if      (kind == 0)  val = ipop();                // int, or a call's result (moved in)
+		else if (kind == 1)  val = spop_new();            // string
+		else                 val = clone(ipop());         // object / array
+		memwrite(arr).mem.push_back(val);
+		vals.resize(vals.size() - (n < 0 ? 1 : n));
+		ipush(0);
+	}
+	void sys_pop(int32_t destroyval) {
+		materialize();
+		auto&   mem = memwrite(ipop()).mem;
+		int32_t val = mem.at(mem.size() - 1);
+		if (destroyval)  destroy(val);
+		mem.pop_back();
+		ipush(val);
+	}
+};